@@ -0,0 +1,82 @@
+/**
+ * Widget Sensors
+ * Benchmark helpers
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+using clock_t = std::chrono::steady_clock;
+
+// Percentiles of a set of durations, in microseconds.
+struct Latency {
+  double p50{};
+  double p99{};
+  double max{};
+};
+
+inline Latency Summarize(std::vector<clock_t::duration>& samples) {
+  if (samples.empty())
+    return {};
+
+  std::sort(samples.begin(), samples.end());
+  auto const us = [&](size_t i) {
+    return std::chrono::duration<double, std::micro>(samples[i]).count();
+  };
+  return { us(samples.size() / 2), us(samples.size() * 99 / 100),
+    us(samples.size() - 1) };
+}
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template<typename T>
+void DoNotOptimize(T const& value) {
+#if defined(_MSC_VER)
+  static_cast<void>(const_cast<T volatile&>(value));
+#else
+  asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+// A snapshot of |sensors| HWiNFO-like sensors, |tick| changing the values.
+inline std::string MakeSnapshot(size_t sensors, uint64_t tick) {
+  std::string s = "{\"sensors\":{";
+  for (size_t i = 0; i < sensors; i++) {
+    if (i != 0)
+      s += ',';
+
+    auto const value = std::to_string(30 + (i * 7 + tick) % 70) + "." +
+                       std::to_string((i + tick) % 10);
+    s += "\"hwinfo=>Sensor " + std::to_string(i) + "\":{\"sensor\":\"Sensor " +
+         std::to_string(i) + "\",\"value\":\"" + value +
+         " \xc2\xb0" "C\",\"valueRaw\":\"" + value + "\"}";
+  }
+  s += "}}";
+  return s;
+}
+}  // namespace bench
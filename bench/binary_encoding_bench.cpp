@@ -0,0 +1,100 @@
+/**
+ * Widget Sensors
+ * Binary encoding benchmark
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench/bench_util.hpp"
+#include "core/binary.hpp"
+#include "nlohmann/json.hpp"
+#include <cstdlib>
+#include <memory>
+
+// Measures the time to encode a frame and the frame size for each
+// subprotocol, with snapshots of 100, 1k and 10k sensors:
+//   binary_encoding_bench [iterations]
+// The server sends JSON frames as they were built, so the "json" row is the
+// same parse and dump through nlohmann::json that the binary encodings go
+// through, as a reference for the library cost alone. Each iteration uses a
+// new sequence number, so nothing is served from the encoder cache.
+
+namespace {
+constexpr size_t kDefaultIterations = 200;
+
+struct Result {
+  bench::Latency encode;
+  size_t bytes{};
+};
+
+Result RunJson(std::string const& json, size_t iterations) {
+  std::vector<bench::clock_t::duration> samples;
+  samples.reserve(iterations);
+  std::string encoded;
+  for (size_t i = 0; i < iterations; i++) {
+    auto const start = bench::clock_t::now();
+    encoded = nlohmann::json::parse(json).dump();
+    samples.push_back(bench::clock_t::now() - start);
+    bench::DoNotOptimize(encoded);
+  }
+  return { bench::Summarize(samples), encoded.size() };
+}
+
+Result RunBinary(std::string const& json,
+    core::Encoding encoding,
+    size_t iterations) {
+  core::BinaryEncoder encoder;
+  auto const owner = std::make_shared<std::string>(json);
+  std::vector<bench::clock_t::duration> samples;
+  samples.reserve(iterations);
+  std::shared_ptr<const std::string> encoded;
+  for (size_t i = 0; i < iterations; i++) {
+    auto const start = bench::clock_t::now();
+    encoded = encoder.Encode(i + 1, owner, *owner, encoding);
+    samples.push_back(bench::clock_t::now() - start);
+    bench::DoNotOptimize(encoded);
+  }
+  return { bench::Summarize(samples),
+    encoded != nullptr ? encoded->size() : 0 };
+}
+
+void Print(const char* name, Result const& r, size_t json_bytes) {
+  std::printf("%-8s encode p50 %9.1f us  p99 %9.1f us  %8zu bytes  %5.1f%%\n",
+      name, r.encode.p50, r.encode.p99, r.bytes,
+      json_bytes > 0 ? 100.0 * r.bytes / json_bytes : 0.0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto const iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                   : kDefaultIterations;
+  for (size_t sensors : { 100, 1000, 10000 }) {
+    auto const json = bench::MakeSnapshot(sensors, 0);
+    std::printf("-- %zu sensors, %zu iterations\n", sensors,
+        static_cast<size_t>(iterations));
+    Print("json", RunJson(json, iterations), json.size());
+    Print("cbor", RunBinary(json, core::Encoding::kCbor, iterations),
+        json.size());
+    Print("msgpack", RunBinary(json, core::Encoding::kMsgPack, iterations),
+        json.size());
+  }
+  return 0;
+}
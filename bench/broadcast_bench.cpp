@@ -0,0 +1,158 @@
+/**
+ * Widget Sensors
+ * Broadcast benchmark
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench/bench_util.hpp"
+#include "websocket/server.hpp"
+#include <websocketpp/client.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// Measures the time from Publish() until every subscriber got the frame,
+// with 1, 10, 100 and 1000 websocket clients on the loopback interface:
+//   broadcast_bench [frames]
+// "shared" hands the same payload to every client, so the server prepares
+// one frame for all of them. "unique" hands each client its own copy, which
+// costs a frame per connection as when every client was sent to separately.
+// On Linux, 1000 clients need more than the default 1024 open files.
+
+namespace {
+using client_t = websocketpp::client<websocketpp::config::asio_client>;
+
+constexpr unsigned kFirstPort = 19870;
+constexpr size_t kDefaultFrames = 100;
+constexpr size_t kSensors = 200;
+
+// Counts events from the client and server threads.
+class Counter {
+public:
+  void Add() {
+    std::lock_guard lock(mutex_);
+    count_++;
+    cv_.notify_all();
+  }
+
+  void Reset() {
+    std::lock_guard lock(mutex_);
+    count_ = 0;
+  }
+
+  void WaitFor(size_t count) {
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [&] { return count_ >= count; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t count_{};
+};
+
+bench::Latency Run(network::WebsocketServer& server,
+    Counter& received,
+    size_t clients,
+    size_t frames,
+    network::payload_provider_t const& provider) {
+  std::vector<bench::clock_t::duration> samples;
+  samples.reserve(frames);
+  for (size_t i = 0; i < frames; i++) {
+    received.Reset();
+    auto const start = bench::clock_t::now();
+    server.Publish(provider);
+    received.WaitFor(clients);
+    samples.push_back(bench::clock_t::now() - start);
+  }
+  return bench::Summarize(samples);
+}
+
+void Print(const char* name, bench::Latency const& r) {
+  std::printf("%-6s delivery p50 %9.1f us  p99 %9.1f us  max %9.1f us\n",
+      name, r.p50, r.p99, r.max);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto const frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                               : kDefaultFrames;
+  auto const json =
+      std::make_shared<const std::string>(bench::MakeSnapshot(kSensors, 0));
+
+  unsigned port = kFirstPort;
+  for (size_t clients : { 1, 10, 100, 1000 }) {
+    Counter subscribed;
+    Counter received;
+    network::WebsocketServer server(port);
+    server.Start([&](network::connection_hdl hdl, std::string const& msg) {
+      if (msg == "subscribe") {
+        server.Subscribe(hdl, std::chrono::milliseconds(0));
+        subscribed.Add();
+      }
+    });
+
+    client_t client;
+    client.clear_access_channels(websocketpp::log::alevel::all);
+    client.clear_error_channels(websocketpp::log::elevel::all);
+    client.init_asio();
+    client.set_open_handler([&](websocketpp::connection_hdl hdl) {
+      client.send(hdl, "subscribe", websocketpp::frame::opcode::TEXT);
+    });
+    client.set_message_handler([&](websocketpp::connection_hdl,
+                                   client_t::message_ptr) { received.Add(); });
+
+    auto const uri = "ws://127.0.0.1:" + std::to_string(port);
+    for (size_t i = 0; i < clients; i++) {
+      websocketpp::lib::error_code ec;
+      auto const con = client.get_connection(uri, ec);
+      if (ec) {
+        std::printf("Cannot connect to %s: %s\n", uri.c_str(),
+            ec.message().c_str());
+        return 1;
+      }
+      client.connect(con);
+    }
+    std::thread runner([&] { client.run(); });
+    subscribed.WaitFor(clients);
+
+    std::printf("-- %zu clients, %zu frames of %zu bytes\n", clients,
+        static_cast<size_t>(frames), json->size());
+    Print("shared",
+        Run(server, received, clients, frames, [json](auto) {
+          return network::Payload{ json, *json };
+        }));
+    Print("unique",
+        Run(server, received, clients, frames, [json](auto) {
+          auto copy = std::make_shared<const std::string>(*json);
+          return network::Payload{ copy, *copy };
+        }));
+
+    client.stop();
+    runner.join();
+    server.Shutdown();
+    port++;
+  }
+  return 0;
+}
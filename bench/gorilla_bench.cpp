@@ -0,0 +1,145 @@
+/**
+ * Widget Sensors
+ * Gorilla compression benchmark
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench/bench_util.hpp"
+#include "core/gorilla.hpp"
+#include "core/replay.hpp"
+#include "core/snapshot.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+
+// Measures how fast the history compresses and decompresses the numeric
+// sensors of a session, and how small it gets:
+//   gorilla_bench [session] [repeats]
+// |session| is anything the replay tool reads: a segment file, a recordings
+// directory or a JSON-lines capture, by default the capture in bench/data.
+// Every numeric sensor becomes a series, encoded into a core::GorillaSeries
+// and decoded back, which must give the same bits.
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "bench/data"
+#endif
+
+namespace {
+constexpr char kDefaultSession[] = BENCH_DATA_DIR "/hwinfo_capture.jsonl";
+constexpr size_t kDefaultRepeats = 5;
+
+using series_t = std::vector<core::TimedValue>;
+
+bool Load(char const* path, std::map<std::string, series_t>& series) {
+  core::ReplayReader reader;
+  if (!reader.Open(path))
+    return false;
+
+  core::ReplayFrame frame;
+  core::Snapshot snapshot;
+  while (reader.Next(frame)) {
+    snapshot.data = std::move(frame.data);
+    if (!snapshot.Index())
+      continue;
+
+    for (auto const& e : snapshot.entries) {
+      double value;
+      if (core::ToNumber(e, value))
+        series[std::string(e.key)].push_back({ frame.time, value });
+    }
+    frame.data = std::move(snapshot.data);
+  }
+  return true;
+}
+
+bool Same(core::TimedValue const& a, core::TimedValue const& b) {
+  return a.time == b.time &&
+         std::memcmp(&a.value, &b.value, sizeof(double)) == 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto const session = argc > 1 ? argv[1] : kDefaultSession;
+  auto const repeats = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                : kDefaultRepeats;
+  std::map<std::string, series_t> series;
+  if (!Load(session, series) || series.empty()) {
+    std::printf("No numeric sensors in %s\n", session);
+    std::printf("Usage: gorilla_bench [session] [repeats]\n");
+    return 1;
+  }
+
+  size_t samples{};
+  for (auto const& [key, s] : series)
+    samples += s.size();
+
+  std::vector<bench::clock_t::duration> encode_times;
+  std::vector<bench::clock_t::duration> decode_times;
+  size_t bytes{};
+  bool exact = true;
+  for (size_t r = 0; r < std::max<size_t>(repeats, 1); r++) {
+    std::vector<core::GorillaSeries> encoded;
+    encoded.reserve(series.size());
+    auto start = bench::clock_t::now();
+    for (auto const& [key, s] : series) {
+      auto& g = encoded.emplace_back(s.size());
+      for (auto const& v : s)
+        g.Append(v.time, v.value);
+    }
+    encode_times.push_back(bench::clock_t::now() - start);
+
+    bytes = 0;
+    for (auto const& g : encoded)
+      bytes += g.bytes();
+
+    std::vector<series_t> decoded(encoded.size());
+    start = bench::clock_t::now();
+    for (size_t i = 0; i < encoded.size(); i++) {
+      encoded[i].Query(std::numeric_limits<int64_t>::min(),
+          std::numeric_limits<int64_t>::max(), 0, decoded[i]);
+    }
+    decode_times.push_back(bench::clock_t::now() - start);
+
+    size_t i = 0;
+    for (auto const& [key, s] : series) {
+      auto const& d = decoded[i++];
+      exact = exact && d.size() == s.size() &&
+              std::equal(d.begin(), d.end(), s.begin(), Same);
+    }
+  }
+
+  auto const rate = [&](std::vector<bench::clock_t::duration>& times) {
+    auto const us = bench::Summarize(times).p50;
+    return us > 0 ? samples / us : 0.0;  // Millions per second
+  };
+  std::printf("%s\n", session);
+  std::printf("%zu series, %zu samples, %zu repeats\n", series.size(),
+      samples, static_cast<size_t>(repeats));
+  std::printf("encode  %8.1f M samples/s\n", rate(encode_times));
+  std::printf("decode  %8.1f M samples/s\n", rate(decode_times));
+  std::printf("size    %8.2f bytes/sample, %.1fx smaller than time and value\n",
+      static_cast<double>(bytes) / samples,
+      bytes > 0 ? 16.0 * samples / bytes : 0.0);
+  std::printf("round trip %s\n", exact ? "exact" : "MISMATCH");
+  return exact ? 0 : 2;
+}
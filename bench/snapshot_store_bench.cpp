@@ -0,0 +1,203 @@
+/**
+ * Widget Sensors
+ * SnapshotStore benchmark
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bench/bench_util.hpp"
+#include "core/snapshot.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// Measures the sampler publishing a snapshot while readers poll the current
+// one every millisecond, as websocket clients do:
+//   snapshot_store_bench [readers] [ticks] [sensors]
+// "mutex" is the previous path: the sampler swaps its buffer under a lock
+// and every reader copies the snapshot under the same lock. "store" is
+// core::SnapshotStore, where readers only take a reference. Each tick is
+// timed in two parts: writing the snapshot, which for the store includes
+// indexing it as it is written from fragments indexed beforehand, and
+// publishing it. Reads are timed on the readers.
+
+namespace {
+constexpr size_t kDefaultReaders = 50;
+constexpr size_t kDefaultTicks = 20000;
+constexpr size_t kDefaultSensors = 200;
+constexpr auto kPollInterval = std::chrono::milliseconds(1);
+// Snapshots cycled through by the sampler, built up front.
+constexpr size_t kVariants = 16;
+
+constexpr std::string_view kPrefix = "{\"sensors\":{";
+constexpr std::string_view kSuffix = "}}";
+
+struct Result {
+  bench::Latency write;
+  bench::Latency publish;
+  bench::Latency read;
+  uint64_t reads{};
+};
+
+// Runs |readers| threads calling |read| every kPollInterval while |tick| is
+// called |ticks| times, and times both.
+template<typename Read, typename Tick>
+Result Run(size_t readers, size_t ticks, Read&& read, Tick&& tick) {
+  std::atomic<bool> quit{};
+  std::mutex samples_mutex;
+  std::vector<bench::clock_t::duration> read_samples;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < readers; i++) {
+    threads.emplace_back([&] {
+      std::vector<bench::clock_t::duration> samples;
+      while (!quit) {
+        auto const start = bench::clock_t::now();
+        read();
+        samples.push_back(bench::clock_t::now() - start);
+        std::this_thread::sleep_for(kPollInterval);
+      }
+
+      std::lock_guard lock(samples_mutex);
+      read_samples.insert(read_samples.end(), samples.begin(), samples.end());
+    });
+  }
+
+  std::vector<bench::clock_t::duration> write_samples;
+  std::vector<bench::clock_t::duration> publish_samples;
+  write_samples.reserve(ticks);
+  publish_samples.reserve(ticks);
+  for (size_t i = 1; i <= ticks; i++) {
+    auto const start = bench::clock_t::now();
+    auto const written = tick(i);
+    auto const end = bench::clock_t::now();
+    write_samples.push_back(written - start);
+    publish_samples.push_back(end - written);
+  }
+
+  quit = true;
+  for (auto& t : threads)
+    t.join();
+
+  Result r;
+  r.write = bench::Summarize(write_samples);
+  r.publish = bench::Summarize(publish_samples);
+  r.reads = read_samples.size();
+  r.read = bench::Summarize(read_samples);
+  return r;
+}
+
+Result RunMutex(size_t readers,
+    size_t ticks,
+    std::vector<std::string> const& snapshots) {
+  std::mutex mutex;
+  std::string json_data = snapshots[0];
+  std::string back_buffer;
+  back_buffer.reserve(json_data.capacity());
+  return Run(
+      readers, ticks,
+      [&] {
+        thread_local std::string send_buffer;
+        {
+          std::lock_guard lock(mutex);
+          send_buffer.assign(json_data);
+        }
+        bench::DoNotOptimize(send_buffer);
+      },
+      [&](size_t tick) {
+        back_buffer.assign(snapshots[tick % snapshots.size()]);
+        auto const written = bench::clock_t::now();
+        std::lock_guard lock(mutex);
+        json_data.swap(back_buffer);
+        return written;
+      });
+}
+
+Result RunStore(size_t readers,
+    size_t ticks,
+    std::vector<std::string> const& snapshots) {
+  // The sensors of each snapshot, indexed up front as the sampler indexes a
+  // plugin fragment once when it changes.
+  std::vector<std::string_view> members;
+  std::vector<std::vector<core::SensorEntry>> indexes(snapshots.size());
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    auto const& s = snapshots[i];
+    members.push_back(std::string_view(s).substr(kPrefix.size(),
+        s.size() - kPrefix.size() - kSuffix.size()));
+    static_cast<void>(core::IndexMembers(members.back(), indexes[i]));
+  }
+
+  core::SnapshotStore store(snapshots[0].size() * 2);
+  return Run(
+      readers, ticks,
+      [&] {
+        auto const snapshot = store.Current();
+        bench::DoNotOptimize(snapshot);
+      },
+      [&](size_t tick) {
+        auto const i = tick % snapshots.size();
+        auto snapshot = store.Acquire();
+        snapshot->BeginIndex();
+        snapshot->data.assign(kPrefix);
+        snapshot->data.append(members[i]);
+        snapshot->AddMembers(kPrefix.size(), members[i], indexes[i]);
+        snapshot->data.append(kSuffix);
+        static_cast<void>(snapshot->EndIndex());
+        auto const written = bench::clock_t::now();
+        store.Publish(std::move(snapshot));
+        return written;
+      });
+}
+
+void Print(const char* name, Result const& r) {
+  std::printf("%-6s write   p50 %8.2f us  p99 %8.2f us  max %9.2f us\n", name,
+      r.write.p50, r.write.p99, r.write.max);
+  std::printf("%-6s publish p50 %8.2f us  p99 %8.2f us  max %9.2f us\n", name,
+      r.publish.p50, r.publish.p99, r.publish.max);
+  std::printf("%-6s read    p50 %8.2f us  p99 %8.2f us  max %9.2f us  "
+              "%llu reads\n",
+      name, r.read.p50, r.read.p99, r.read.max,
+      static_cast<unsigned long long>(r.reads));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto const readers = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                : kDefaultReaders;
+  auto const ticks = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                              : kDefaultTicks;
+  auto const sensors = argc > 3 ? std::strtoul(argv[3], nullptr, 10)
+                                : kDefaultSensors;
+
+  std::vector<std::string> snapshots;
+  for (size_t i = 0; i < kVariants; i++)
+    snapshots.push_back(bench::MakeSnapshot(sensors, i));
+
+  std::printf("%zu ticks, %zu sensors (%zu bytes), %u hardware threads\n",
+      static_cast<size_t>(ticks), static_cast<size_t>(sensors),
+      snapshots[0].size(), std::thread::hardware_concurrency());
+  for (size_t r : { size_t{ 0 }, static_cast<size_t>(readers) }) {
+    std::printf("-- %zu readers\n", r);
+    Print("mutex", RunMutex(r, ticks, snapshots));
+    Print("store", RunStore(r, ticks, snapshots));
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/**
+ * Widget Sensors
+ * Binary encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/binary.hpp"
+#include "core/snapshot.hpp"
+#include "nlohmann/json.hpp"
+#include <cmath>
+
+namespace core {
+namespace {
+constexpr double kMaxExactInteger = 9007199254740992.0;  // 2^53
+
+void ConvertNumbers(nlohmann::json& j) {
+  if (j.is_array()) {
+    for (auto& v : j)
+      ConvertNumbers(v);
+
+    return;
+  }
+
+  if (!j.is_object())
+    return;
+
+  for (auto&& [key, value] : j.items()) {
+    if (!value.is_string()) {
+      ConvertNumbers(value);
+      continue;
+    }
+
+    if (key != "value" && key != "valueRaw")
+      continue;
+
+    double number;
+    if (!ToNumber(value.get_ref<std::string const&>(), number, false))
+      continue;
+
+    if (number == std::floor(number) && std::fabs(number) < kMaxExactInteger)
+      value = static_cast<int64_t>(number);
+    else
+      value = number;
+  }
+}
+}  // namespace
+
+Encoding EncodingFromSubprotocol(std::string_view subprotocol) {
+  if (subprotocol == kCborSubprotocol)
+    return Encoding::kCbor;
+  else if (subprotocol == kMsgPackSubprotocol)
+    return Encoding::kMsgPack;
+
+  return Encoding::kJson;
+}
+
+std::shared_ptr<const std::string> BinaryEncoder::Encode(uint64_t seq,
+    std::shared_ptr<const void> const& owner,
+    std::string_view json,
+    Encoding encoding) {
+  if (seq_ != seq) {
+    seq_ = seq;
+    cache_.clear();
+  }
+
+  for (auto const& c : cache_) {
+    if (c.json.data() == json.data() && c.json.size() == json.size() &&
+        c.encoding == encoding)
+      return c.encoded;
+  }
+
+  nlohmann::json j;
+  try {
+    j = nlohmann::json::parse(json.begin(), json.end());
+  } catch (...) {
+    return nullptr;
+  }
+
+  ConvertNumbers(j);
+
+  auto encoded = std::make_shared<std::string>();
+  if (encoding == Encoding::kCbor)
+    nlohmann::json::to_cbor(j, *encoded);
+  else
+    nlohmann::json::to_msgpack(j, *encoded);
+
+  cache_.push_back({ owner, json, encoding, encoded });
+  return encoded;
+}
+}  // namespace core
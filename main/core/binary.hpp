@@ -0,0 +1,65 @@
+/**
+ * Widget Sensors
+ * Binary encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+enum class Encoding { kJson, kCbor, kMsgPack };
+
+inline constexpr char kCborSubprotocol[] = "widget-sensors.cbor";
+inline constexpr char kMsgPackSubprotocol[] = "widget-sensors.msgpack";
+
+[[nodiscard]] Encoding EncodingFromSubprotocol(std::string_view subprotocol);
+
+// Re-encodes JSON frames as CBOR or MessagePack for clients that negotiated
+// one of the binary subprotocols. Numbers sent as text, such as
+// "valueRaw":"3724.8", become native numbers. Encoded frames are cached until
+// the snapshot sequence changes, so clients sharing a frame share its
+// encoding too. Not thread safe, meant to be used from the websocket server
+// thread.
+class BinaryEncoder {
+public:
+  // Returns nullptr if |json| could not be parsed.
+  [[nodiscard]] std::shared_ptr<const std::string> Encode(uint64_t seq,
+      std::shared_ptr<const void> const& owner,
+      std::string_view json,
+      Encoding encoding);
+
+private:
+  struct CachedFrame {
+    std::shared_ptr<const void> owner;  // Keeps |json| alive.
+    std::string_view json;
+    Encoding encoding{};
+    std::shared_ptr<const std::string> encoded;
+  };
+
+  uint64_t seq_{};
+  std::vector<CachedFrame> cache_;
+};
+}  // namespace core
@@ -0,0 +1,61 @@
+/**
+ * Widget Sensors
+ * Change notification set
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace core {
+// Fixed size set of ids flagged as changed. Mark() can be called from any
+// thread, Take() from the single consumer that acts on the changes.
+template<size_t N>
+class ChangeSet {
+public:
+  static constexpr size_t kCapacity = N;
+
+  // Returns true if |id| was not marked already. Ids out of range are
+  // ignored.
+  bool Mark(size_t id) {
+    if (id >= N)
+      return false;
+
+    return !marked_[id].exchange(true, std::memory_order_acq_rel);
+  }
+
+  // Appends the marked ids to |ids| and clears them.
+  void Take(std::vector<size_t>& ids) {
+    for (size_t i = 0; i < N; i++) {
+      if (marked_[i].load(std::memory_order_relaxed) &&
+          marked_[i].exchange(false, std::memory_order_acq_rel))
+        ids.push_back(i);
+    }
+  }
+
+private:
+  std::array<std::atomic<bool>, N> marked_{};
+};
+}  // namespace core
@@ -0,0 +1,121 @@
+/**
+ * Widget Sensors
+ * Compact encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/compact.hpp"
+#include "shared/json_writer.hpp"
+#include <algorithm>
+
+namespace core {
+namespace {
+bool IsQuoted(std::string_view v) {
+  return v.size() >= 2 && v.front() == '"' && v.back() == '"';
+}
+
+// Values are copied as they appear in the snapshot: text that only looks
+// like a number, such as a process named "2048", stays a string.
+void WriteValue(util::JsonWriter& writer, SensorEntry const& e) {
+  auto v = !e.raw.empty() && e.raw != "\"\"" ? e.raw : e.display;
+  if (v.empty())
+    v = e.value;
+
+  writer.RawValue(v);
+}
+}  // namespace
+
+CompactEncoder::Frame CompactEncoder::Get(snapshot_ptr_t const& snapshot,
+    std::shared_ptr<Projection> const& projection) {
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                     [](auto&& e) {
+                       return e.projection != nullptr &&
+                              e.projection.use_count() == 1;
+                     }),
+      entries_.end());
+
+  auto it = std::find_if(entries_.begin(), entries_.end(),
+      [&](auto&& e) { return e.projection == projection; });
+  if (it == entries_.end())
+    it = entries_.insert(entries_.end(),
+        Entry{ projection, 0, 0, Frame{} });
+
+  auto& entry = *it;
+  if (entry.frame.values != nullptr && entry.seq == snapshot->seq)
+    return entry.frame;
+
+  const auto included = [&](SensorEntry const& e) {
+    return projection == nullptr || projection->Contains(e.key);
+  };
+
+  if (entry.frame.schema == nullptr ||
+      entry.key_set_hash != snapshot->key_set_hash) {
+    entry.key_set_hash = snapshot->key_set_hash;
+    entry.frame.version = ++next_version_;
+
+    auto schema = std::make_shared<std::string>();
+    util::JsonWriter writer(*schema);
+    writer.BeginObject();
+    writer.Key("schema");
+    writer.BeginObject();
+    writer.Key("version");
+    writer.Number(entry.frame.version);
+    writer.Key("sensors");
+    writer.BeginArray();
+    for (auto const& e : snapshot->entries) {
+      if (!included(e))
+        continue;
+
+      writer.BeginObject();
+      writer.Key("key");
+      writer.RawString(e.key);
+      writer.Key("label");
+      if (IsQuoted(e.label))
+        writer.RawValue(e.label);
+      else
+        writer.RawString(e.key);
+      writer.Key("unit");
+      writer.RawString(UnitOf(e));
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    writer.EndObject();
+    entry.frame.schema = std::move(schema);
+  }
+
+  auto values = std::make_shared<std::string>();
+  util::JsonWriter writer(*values);
+  writer.BeginArray();
+  writer.Number(entry.frame.version);
+  writer.Number(snapshot->seq);
+  for (auto const& e : snapshot->entries) {
+    if (included(e))
+      WriteValue(writer, e);
+  }
+  writer.EndArray();
+
+  entry.seq = snapshot->seq;
+  entry.frame.values = std::move(values);
+  return entry.frame;
+}
+}  // namespace core
@@ -0,0 +1,62 @@
+/**
+ * Widget Sensors
+ * Compact encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/projection.hpp"
+#include "core/snapshot.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+// Schema-once protocol. The schema message maps array positions to sensors:
+//   {"schema":{"version":3,"sensors":[{"key":"rtss=>framerate",
+//     "label":"framerate","unit":""},...]}}
+// and each frame is a flat array of [version, seq, value0, value1, ...].
+// A new schema version is created whenever the set of keys changes.
+// Not thread safe, meant to be used from the websocket server thread.
+class CompactEncoder {
+public:
+  struct Frame {
+    uint32_t version{};
+    std::shared_ptr<const std::string> schema;
+    std::shared_ptr<const std::string> values;
+  };
+
+  [[nodiscard]] Frame Get(snapshot_ptr_t const& snapshot,
+      std::shared_ptr<Projection> const& projection);
+
+private:
+  struct Entry {
+    std::shared_ptr<Projection> projection;
+    uint64_t key_set_hash{};
+    uint64_t seq{};
+    Frame frame;
+  };
+
+  std::vector<Entry> entries_;
+  uint32_t next_version_{};
+};
+}  // namespace core
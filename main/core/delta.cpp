@@ -0,0 +1,106 @@
+/**
+ * Widget Sensors
+ * Delta encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/delta.hpp"
+#include "shared/json_writer.hpp"
+
+namespace core {
+DeltaFrame DeltaEncoder::Get(snapshot_ptr_t const& snapshot,
+    uint64_t base,
+    std::shared_ptr<Projection> const& projection) {
+  Remember(*snapshot);
+
+  auto const old = Find(base);
+  auto const full = old == nullptr ||
+                    old->key_set_hash != snapshot->key_set_hash ||
+                    old->hashes.size() != snapshot->entries.size();
+  if (full)
+    base = 0;
+
+  if (cached_seq_ != snapshot->seq) {
+    cached_seq_ = snapshot->seq;
+    cache_.clear();
+  }
+
+  for (auto const& c : cache_) {
+    if (c.base == base && c.projection == projection)
+      return c.frame;
+  }
+
+  auto payload = std::make_shared<std::string>();
+  util::JsonWriter writer(*payload);
+  writer.BeginObject();
+  writer.Key("seq");
+  writer.Number(snapshot->seq);
+  if (full) {
+    writer.Key("full");
+    writer.Bool(true);
+  } else {
+    writer.Key("base");
+    writer.Number(base);
+  }
+  writer.Key("sensors");
+  writer.BeginObject();
+
+  size_t changed{};
+  auto const& entries = snapshot->entries;
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto const& e = entries[i];
+    if (projection != nullptr && !projection->Contains(e.key))
+      continue;
+
+    if (full || old->hashes[i] != e.hash) {
+      writer.RawMembers(e.member);
+      changed++;
+    }
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  DeltaFrame frame{ std::move(payload), changed, full };
+  cache_.push_back({ base, projection, frame });
+  return frame;
+}
+
+void DeltaEncoder::Remember(Snapshot const& snapshot) {
+  auto& d = history_[snapshot.seq % kHistorySize];
+  if (d.seq == snapshot.seq)
+    return;
+
+  d.seq = snapshot.seq;
+  d.key_set_hash = snapshot.key_set_hash;
+  d.hashes.clear();
+  for (auto const& e : snapshot.entries)
+    d.hashes.push_back(e.hash);
+}
+
+DeltaEncoder::Digest const* DeltaEncoder::Find(uint64_t seq) const {
+  if (seq == 0)
+    return nullptr;
+
+  auto const& d = history_[seq % kHistorySize];
+  return d.seq == seq ? &d : nullptr;
+}
+}  // namespace core
@@ -0,0 +1,76 @@
+/**
+ * Widget Sensors
+ * Delta encoding
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/projection.hpp"
+#include "core/snapshot.hpp"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+struct DeltaFrame {
+  std::shared_ptr<const std::string> payload;
+  size_t changed{};  // Number of sensors in the frame.
+  bool full{};
+};
+
+// Encodes snapshots as the set of sensors that changed since a sequence a
+// client already has:
+//   {"seq":12,"base":10,"sensors":{...changed members...}}
+// or, when |base| is unknown, too old or the key set has changed since then:
+//   {"seq":12,"full":true,"sensors":{...}}
+// Frames are cached per snapshot, so clients on the same base share them.
+// Not thread safe, meant to be used from the websocket server thread.
+class DeltaEncoder {
+public:
+  [[nodiscard]] DeltaFrame Get(snapshot_ptr_t const& snapshot,
+      uint64_t base,
+      std::shared_ptr<Projection> const& projection);
+
+private:
+  static constexpr size_t kHistorySize = 64;
+
+  struct Digest {
+    uint64_t seq{};
+    uint64_t key_set_hash{};
+    std::vector<uint64_t> hashes;
+  };
+
+  struct CachedFrame {
+    uint64_t base{};
+    std::shared_ptr<Projection> projection;
+    DeltaFrame frame;
+  };
+
+  void Remember(Snapshot const& snapshot);
+  [[nodiscard]] Digest const* Find(uint64_t seq) const;
+
+  std::array<Digest, kHistorySize> history_;
+  uint64_t cached_seq_{};
+  std::vector<CachedFrame> cache_;
+};
+}  // namespace core
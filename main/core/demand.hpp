@@ -0,0 +1,58 @@
+/**
+ * Widget Sensors
+ * Sensor demand tracking
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+namespace core {
+// Sensor keys read by the connected clients, so sources nobody reads can be
+// suspended. Updated by the websocket server thread, read by the sampler.
+class DemandTracker {
+public:
+  struct Demand {
+    // Some client reads every key, i.e. has no projection.
+    bool everything{};
+    std::set<std::string, std::less<>> keys;
+
+    [[nodiscard]] bool Reads(std::string_view key) const {
+      return everything || keys.find(key) != keys.end();
+    }
+  };
+
+  DemandTracker();
+
+  void Set(std::shared_ptr<const Demand> demand);
+  [[nodiscard]] std::shared_ptr<const Demand> Get() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Demand> demand_;
+};
+}  // namespace core
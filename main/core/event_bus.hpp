@@ -0,0 +1,151 @@
+/**
+ * Widget Sensors
+ * Event bus
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace core {
+// Tells a handler whether the event it is working on was superseded.
+class CancelToken {
+public:
+  CancelToken(std::atomic<uint64_t> const& latest, uint64_t generation)
+      : latest_(&latest), generation_(generation) {
+  }
+
+  [[nodiscard]] bool cancelled() const {
+    return latest_->load(std::memory_order_acquire) != generation_;
+  }
+
+private:
+  std::atomic<uint64_t> const* latest_;
+  uint64_t generation_;
+};
+
+// Delivers events to each subscriber on its own worker thread, so Post()
+// never waits for a handler and a slow subscriber only delays itself. Only
+// the latest event matters: a new one replaces any event a subscriber did
+// not get to yet, and cancels the token of the one it is handling.
+template<typename Event>
+class EventBus {
+public:
+  using handler_t = std::function<void(Event const&, CancelToken const&)>;
+
+  EventBus() = default;
+  ~EventBus() {
+    Stop();
+  }
+
+  EventBus(EventBus const&) = delete;
+  EventBus& operator=(EventBus const&) = delete;
+
+  // Must be called before events are posted. Returns the id of the
+  // subscriber.
+  size_t Subscribe(handler_t handler) {
+    auto& s = *subscribers_.emplace_back(std::make_unique<Subscriber>());
+    s.handler = std::move(handler);
+    s.worker = std::thread(&EventBus::Run, &s);
+    return subscribers_.size() - 1;
+  }
+
+  // Can be called from any thread.
+  void Post(Event const& event) {
+    for (auto& s : subscribers_)
+      Deliver(*s, event);
+  }
+
+  // Delivers |event| to subscriber |id| only, e.g. to replay an event it
+  // could not handle at the time.
+  void Post(size_t id, Event const& event) {
+    if (id < subscribers_.size())
+      Deliver(*subscribers_[id], event);
+  }
+
+  // Drops pending events and waits for the running handlers to return.
+  void Stop() {
+    for (auto& s : subscribers_) {
+      {
+        std::lock_guard lock(s->mutex);
+        s->pending.reset();
+        s->quit = true;
+        s->latest.fetch_add(1, std::memory_order_acq_rel);
+      }
+      s->cv.notify_one();
+    }
+
+    for (auto& s : subscribers_) {
+      if (s->worker.joinable())
+        s->worker.join();
+    }
+    subscribers_.clear();
+  }
+
+private:
+  struct Subscriber {
+    handler_t handler;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::optional<Event> pending;
+    std::atomic<uint64_t> latest{};
+    bool quit{};
+    std::thread worker;
+  };
+
+  static void Deliver(Subscriber& s, Event const& event) {
+    {
+      std::lock_guard lock(s.mutex);
+      s.pending = event;
+      s.latest.fetch_add(1, std::memory_order_acq_rel);
+    }
+    s.cv.notify_one();
+  }
+
+  static void Run(Subscriber* s) {
+    std::unique_lock lock(s->mutex);
+    for (;;) {
+      s->cv.wait(lock, [s] { return s->quit || s->pending.has_value(); });
+      if (s->quit)
+        return;
+
+      auto event = std::move(*s->pending);
+      s->pending.reset();
+      CancelToken const token(s->latest, s->latest.load());
+      lock.unlock();
+      s->handler(event, token);
+      lock.lock();
+    }
+  }
+
+  std::vector<std::unique_ptr<Subscriber>> subscribers_;
+};
+}  // namespace core
@@ -0,0 +1,291 @@
+/**
+ * Widget Sensors
+ * Compressed time series
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/gorilla.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace core {
+namespace {
+unsigned LeadingZeros(uint64_t v) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  return _BitScanReverse64(&index, v) ? 63 - index : 64;
+#else
+  return v != 0 ? __builtin_clzll(v) : 64;
+#endif
+}
+
+unsigned TrailingZeros(uint64_t v) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  return _BitScanForward64(&index, v) ? index : 64;
+#else
+  return v != 0 ? __builtin_ctzll(v) : 64;
+#endif
+}
+
+uint64_t ToBits(double v) {
+  uint64_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+double FromBits(uint64_t bits) {
+  double v;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+// Delta of delta ranges: prefix, prefix length and value bits. Values are
+// stored with a bias so that they are never negative.
+struct DodRange {
+  uint64_t prefix;
+  unsigned prefix_bits;
+  unsigned value_bits;
+};
+constexpr DodRange kDodRanges[] = {
+  { 0b10, 2, 7 },
+  { 0b110, 3, 9 },
+  { 0b1110, 4, 12 },
+};
+
+int64_t Bias(unsigned bits) {
+  return (int64_t{ 1 } << (bits - 1)) - 1;
+}
+
+class BitReader {
+public:
+  explicit BitReader(std::vector<uint64_t> const& words) : words_(words) {
+  }
+
+  uint64_t Read(unsigned count) {
+    uint64_t bits{};
+    while (count != 0) {
+      auto const offset = static_cast<unsigned>(pos_ % 64);
+      auto const n = std::min(count, 64 - offset);
+      auto const word = words_[pos_ / 64] << offset;
+      bits = n == 64 ? word : (bits << n) | (word >> (64 - n));
+      pos_ += n;
+      count -= n;
+    }
+    return bits;
+  }
+
+  bool ReadBit() {
+    return Read(1) != 0;
+  }
+
+private:
+  std::vector<uint64_t> const& words_;
+  size_t pos_{};
+};
+}  // namespace
+
+void GorillaBlock::Write(uint64_t bits, unsigned count) {
+  while (count != 0) {
+    auto const offset = static_cast<unsigned>(bit_count_ % 64);
+    if (offset == 0)
+      words_.push_back(0);
+
+    auto const n = std::min(count, 64 - offset);
+    auto const chunk = n == 64 ? bits : (bits >> (count - n)) &
+                                            ((uint64_t{ 1 } << n) - 1);
+    words_.back() |= chunk << (64 - offset - n);
+    bit_count_ += n;
+    count -= n;
+  }
+}
+
+bool GorillaBlock::Append(int64_t time, double value) {
+  if (size_ == kMaxSamples || (size_ != 0 && time < last_time_))
+    return false;
+
+  auto const bits = ToBits(value);
+  if (size_ == 0) {
+    Write(static_cast<uint64_t>(time), 64);
+    Write(bits, 64);
+    first_time_ = time;
+  } else {
+    auto const delta = time - last_time_;
+    auto const dod = delta - last_delta_;
+    if (dod == 0) {
+      Write(0, 1);
+    } else {
+      bool written = false;
+      for (auto const& r : kDodRanges) {
+        auto const bias = Bias(r.value_bits);
+        if (dod >= -bias && dod <= bias + 1) {
+          Write(r.prefix, r.prefix_bits);
+          Write(static_cast<uint64_t>(dod + bias), r.value_bits);
+          written = true;
+          break;
+        }
+      }
+      if (!written) {
+        Write(0b1111, 4);
+        Write(static_cast<uint64_t>(dod), 64);
+      }
+    }
+    last_delta_ = delta;
+
+    auto const x = bits ^ last_value_;
+    if (x == 0) {
+      Write(0, 1);
+    } else {
+      auto const leading = std::min(LeadingZeros(x), 31u);
+      auto const trailing = TrailingZeros(x);
+      if (leading_ != 64 && leading >= leading_ && trailing >= trailing_) {
+        // Fits in the window of the previous value.
+        Write(0b10, 2);
+        Write(x >> trailing_, 64 - leading_ - trailing_);
+      } else {
+        auto const significant = 64 - leading - trailing;
+        Write(0b11, 2);
+        Write(leading, 5);
+        Write(significant - 1, 6);
+        Write(x >> trailing, significant);
+        leading_ = leading;
+        trailing_ = trailing;
+      }
+    }
+  }
+
+  last_time_ = time;
+  last_value_ = bits;
+  size_++;
+  return true;
+}
+
+void GorillaBlock::Decode(int64_t from,
+    int64_t to,
+    std::vector<TimedValue>& out) const {
+  if (size_ == 0 || last_time_ < from || first_time_ > to)
+    return;
+
+  BitReader reader(words_);
+  auto time = static_cast<int64_t>(reader.Read(64));
+  auto bits = reader.Read(64);
+  int64_t delta{};
+  unsigned leading{};
+  unsigned trailing{};
+  for (size_t i = 0;; i++) {
+    if (time > to)
+      return;
+
+    if (time >= from)
+      out.push_back({ time, FromBits(bits) });
+
+    if (i + 1 == size_)
+      return;
+
+    // '0', '10', '110', '1110' or '1111' for the delta of delta.
+    int64_t dod{};
+    if (reader.ReadBit()) {
+      size_t range = 0;
+      while (range < std::size(kDodRanges) && reader.ReadBit())
+        range++;
+
+      if (range < std::size(kDodRanges)) {
+        auto const value_bits = kDodRanges[range].value_bits;
+        dod = static_cast<int64_t>(reader.Read(value_bits)) - Bias(value_bits);
+      } else {
+        dod = static_cast<int64_t>(reader.Read(64));
+      }
+    }
+    delta += dod;
+    time += delta;
+
+    // '0' for the same value, '10' for a XOR within the previous window or
+    // '11' followed by the new window.
+    if (reader.ReadBit()) {
+      if (reader.ReadBit()) {
+        leading = static_cast<unsigned>(reader.Read(5));
+        auto const significant = static_cast<unsigned>(reader.Read(6)) + 1;
+        trailing = 64 - leading - significant;
+      }
+      bits ^= reader.Read(64 - leading - trailing) << trailing;
+    }
+  }
+}
+
+void GorillaSeries::Append(int64_t time, double value) {
+  // Queries rely on the blocks being in time order, so a sample older than
+  // the last one, e.g. after the clock was set back, is taken as at the same
+  // time rather than starting a block that would break it.
+  if (!blocks_.empty())
+    time = std::max(time, blocks_.back().last_time());
+
+  if (blocks_.empty() || !blocks_.back().Append(time, value)) {
+    if (!blocks_.empty())
+      blocks_.back().Shrink();
+
+    blocks_.emplace_back().Append(time, value);
+  }
+  size_++;
+
+  while (capacity_ != 0 && size_ - blocks_.front().size() >= capacity_) {
+    size_ -= blocks_.front().size();
+    blocks_.pop_front();
+  }
+}
+
+void GorillaSeries::Query(int64_t from,
+    int64_t to,
+    size_t last,
+    std::vector<TimedValue>& out) const {
+  // With |last| set, older blocks are only needed while the newer ones may
+  // not hold enough samples.
+  auto first = blocks_.begin();
+  if (last != 0) {
+    size_t count{};
+    for (auto it = blocks_.end(); it != blocks_.begin() && count < last;) {
+      --it;
+      if (it->first_time() <= to && it->last_time() >= from) {
+        count += it->size();
+        first = it;
+      }
+    }
+  }
+
+  auto const start = out.size();
+  for (auto it = first; it != blocks_.end(); ++it)
+    it->Decode(from, to, out);
+
+  if (last != 0 && out.size() - start > last)
+    out.erase(out.begin() + start, out.end() - last);
+}
+
+size_t GorillaSeries::bytes() const {
+  size_t bytes{};
+  for (auto const& b : blocks_)
+    bytes += b.bytes();
+  return bytes;
+}
+}  // namespace core
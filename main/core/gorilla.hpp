@@ -0,0 +1,119 @@
+/**
+ * Widget Sensors
+ * Compressed time series
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace core {
+struct TimedValue {
+  int64_t time{};  // Milliseconds since the epoch
+  double value{};
+};
+
+// Samples compressed as in Facebook's Gorilla: times as the delta of their
+// deltas, which is 0 for a regular period and takes a single bit, and values
+// XORed with the previous one, so that an unchanged value takes a single bit
+// and a slow changing one only its differing bits. A block is decoded without
+// any other block.
+class GorillaBlock {
+public:
+  static constexpr size_t kMaxSamples = 512;
+
+  // Returns false if the block is full or |time| is older than the last
+  // sample, in which case a new block has to be started.
+  bool Append(int64_t time, double value);
+
+  // Appends the samples in [from, to] to |out|, oldest first.
+  void Decode(int64_t from, int64_t to, std::vector<TimedValue>& out) const;
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] int64_t first_time() const {
+    return first_time_;
+  }
+
+  [[nodiscard]] int64_t last_time() const {
+    return last_time_;
+  }
+
+  [[nodiscard]] size_t bytes() const {
+    return words_.capacity() * sizeof(uint64_t);
+  }
+
+  void Shrink() {
+    words_.shrink_to_fit();
+  }
+
+private:
+  void Write(uint64_t bits, unsigned count);
+
+  std::vector<uint64_t> words_;
+  size_t bit_count_{};
+  size_t size_{};
+  int64_t first_time_{};
+  // Encoder state.
+  int64_t last_time_{};
+  int64_t last_delta_{};
+  uint64_t last_value_{};
+  unsigned leading_{ 64 };
+  unsigned trailing_{};
+};
+
+// Compressed samples of a sensor, in blocks of GorillaBlock::kMaxSamples.
+// Whole blocks are dropped once more than |capacity| samples are kept.
+class GorillaSeries {
+public:
+  GorillaSeries() = default;
+  explicit GorillaSeries(size_t capacity) : capacity_(capacity) {
+  }
+
+  // A |time| older than the last sample's is replaced by the latter.
+  void Append(int64_t time, double value);
+
+  // Appends the samples taken in [from, to] to |out|, oldest first. A
+  // non-zero |last| keeps only the newest |last| of them. Only the blocks
+  // that can hold such samples are decoded.
+  void Query(int64_t from,
+      int64_t to,
+      size_t last,
+      std::vector<TimedValue>& out) const;
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] size_t bytes() const;
+
+private:
+  size_t capacity_{};
+  size_t size_{};
+  std::deque<GorillaBlock> blocks_;
+};
+}  // namespace core
@@ -0,0 +1,92 @@
+/**
+ * Widget Sensors
+ * Latency histogram
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace core {
+// Latency histogram with power of two buckets from 250 us up to about one
+// second, plus an overflow bucket.
+class LatencyHistogram {
+public:
+  using duration_t = std::chrono::steady_clock::duration;
+
+  static constexpr size_t kBuckets = 14;
+
+  [[nodiscard]] static duration_t UpperBound(size_t bucket) {
+    if (bucket + 1 >= kBuckets)
+      return duration_t::max();
+
+    return std::chrono::duration_cast<duration_t>(
+        std::chrono::microseconds(250) * (int64_t{ 1 } << bucket));
+  }
+
+  void Record(duration_t d) {
+    size_t i = 0;
+    while (i + 1 < kBuckets && d > UpperBound(i))
+      i++;
+
+    buckets_[i]++;
+    count_++;
+    max_ = std::max(max_, d);
+  }
+
+  // Upper bound of the bucket that holds the |q| quantile, e.g. 0.99. Values
+  // in the overflow bucket are reported as the maximum seen.
+  [[nodiscard]] duration_t Quantile(double q) const {
+    if (count_ == 0)
+      return {};
+
+    auto const rank = static_cast<uint64_t>(q * (count_ - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i + 1 < kBuckets; i++) {
+      seen += buckets_[i];
+      if (seen >= rank)
+        return std::min(UpperBound(i), max_);
+    }
+    return max_;
+  }
+
+  [[nodiscard]] uint64_t count() const {
+    return count_;
+  }
+
+  [[nodiscard]] duration_t max() const {
+    return max_;
+  }
+
+  [[nodiscard]] std::array<uint64_t, kBuckets> const& buckets() const {
+    return buckets_;
+  }
+
+private:
+  std::array<uint64_t, kBuckets> buckets_{};
+  uint64_t count_{};
+  duration_t max_{};
+};
+}  // namespace core
@@ -0,0 +1,206 @@
+/**
+ * Widget Sensors
+ * Sensor history
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/history.hpp"
+#include <mutex>
+
+namespace core {
+std::vector<SensorHistory::Level> SensorHistory::DefaultLevels() {
+  return { { 1000, 600 }, { 10000, 360 }, { 60000, 1440 },
+    { 600000, 1008 } };
+}
+
+SensorHistory::SensorHistory(size_t capacity, std::vector<Level> levels)
+    : capacity_(capacity), levels_(std::move(levels)) {
+  levels_.erase(std::remove_if(levels_.begin(), levels_.end(),
+                    [](auto&& l) {
+                      return l.resolution <= 0 || l.buckets == 0;
+                    }),
+      levels_.end());
+  std::sort(levels_.begin(), levels_.end(),
+      [](auto&& a, auto&& b) { return a.resolution < b.resolution; });
+  for (auto const& l : levels_) {
+    retention_ = std::max(retention_,
+        l.resolution * static_cast<int64_t>(l.buckets));
+  }
+}
+
+void SensorHistory::Add(Snapshot const& snapshot, int64_t time) {
+  if (capacity_ == 0 && levels_.empty())
+    return;
+
+  std::unique_lock lock(mutex_);
+  if (index_.empty() || key_set_hash_ != snapshot.key_set_hash) {
+    key_set_hash_ = snapshot.key_set_hash;
+    index_.clear();
+    for (auto const& e : snapshot.entries) {
+      auto it = series_.find(e.key);
+      if (it == series_.end()) {
+        it = series_.emplace(std::string(e.key),
+                        Series{ GorillaSeries(capacity_), {} })
+                 .first;
+      }
+
+      index_.push_back(&it->second);
+    }
+  }
+
+  for (size_t i = 0; i < snapshot.entries.size(); i++) {
+    auto& s = *index_[i];
+    double value;
+    if (!ToNumber(snapshot.entries[i], value)) {
+      s.has_value = false;
+      s.last_time = time;
+      continue;
+    }
+
+    if (capacity_ != 0)
+      s.samples.Append(time, value);
+
+    // The previous value held until now if the sensor was in the previous
+    // snapshot too; otherwise it is unknown since then.
+    if (s.has_value && s.last_time == last_add_ && time > s.last_time)
+      Carry(s, s.last_time, time, s.last_value);
+    Roll(s, time, value);
+    s.last_time = time;
+    s.last_value = value;
+    s.has_value = true;
+  }
+  last_add_ = time;
+
+  if (retention_ != 0 && time - last_prune_ >= kPruneIntervalMs) {
+    last_prune_ = time;
+    Prune(time);
+  }
+}
+
+SensorHistory::Bucket& SensorHistory::GetBucket(Ring<Bucket>& r,
+    Level const& level,
+    int64_t start,
+    double value) {
+  if (r.size == 0 || r.newest().time < start) {
+    auto const v = static_cast<float>(value);
+    r.Push({ start, 0.0, v, v, 0, 0 }, level.buckets);
+  }
+  return r.newest();
+}
+
+void SensorHistory::Roll(Series& s, int64_t time, double value) {
+  if (s.rollups.empty())
+    s.rollups.resize(levels_.size());
+
+  for (size_t i = 0; i < levels_.size(); i++) {
+    auto const start = time - time % levels_[i].resolution;
+    auto& b = GetBucket(s.rollups[i], levels_[i], start, value);
+    b.min = std::min(b.min, static_cast<float>(value));
+    b.max = std::max(b.max, static_cast<float>(value));
+    b.count++;
+  }
+}
+
+// Credits |value| to the buckets of [from, to).
+void SensorHistory::Carry(Series& s, int64_t from, int64_t to, double value) {
+  for (size_t i = 0; i < levels_.size(); i++) {
+    auto const& level = levels_[i];
+    auto& r = s.rollups[i];
+    // Buckets older than the ring holds would be overwritten right away.
+    auto t = std::max(from,
+        to - level.resolution * static_cast<int64_t>(level.buckets));
+    while (t < to) {
+      auto const start = t - t % level.resolution;
+      auto const end = std::min(start + level.resolution, to);
+      auto& b = GetBucket(r, level, start, value);
+      if (b.time == start) {
+        b.sum += value * static_cast<double>(end - t);
+        b.duration += static_cast<uint32_t>(end - t);
+        b.min = std::min(b.min, static_cast<float>(value));
+        b.max = std::max(b.max, static_cast<float>(value));
+      }
+      t = end;
+    }
+  }
+}
+
+void SensorHistory::Prune(int64_t time) {
+  for (auto it = series_.begin(); it != series_.end();) {
+    if (time - it->second.last_time > retention_)
+      it = series_.erase(it);
+    else
+      ++it;
+  }
+}
+
+bool SensorHistory::Query(std::string_view key,
+    int64_t from,
+    int64_t to,
+    size_t last,
+    std::vector<Sample>& out) const {
+  std::shared_lock lock(mutex_);
+  auto const it = series_.find(key);
+  if (it == series_.end() || it->second.samples.size() == 0)
+    return false;
+
+  it->second.samples.Query(from, to, last, out);
+  return true;
+}
+
+size_t SensorHistory::FindLevel(int64_t resolution) const {
+  for (size_t i = 0; i < levels_.size(); i++) {
+    if (levels_[i].resolution >= resolution)
+      return i;
+  }
+  return levels_.size() - 1;
+}
+
+int64_t SensorHistory::RollupResolution(int64_t resolution) const {
+  return levels_.empty() ? 0 : levels_[FindLevel(resolution)].resolution;
+}
+
+bool SensorHistory::QueryRollup(std::string_view key,
+    int64_t resolution,
+    int64_t from,
+    int64_t to,
+    size_t last,
+    std::vector<Bucket>& out) const {
+  if (levels_.empty())
+    return false;
+
+  std::shared_lock lock(mutex_);
+  auto const it = series_.find(key);
+  if (it == series_.end() || it->second.rollups.empty())
+    return false;
+
+  it->second.rollups[FindLevel(resolution)].Copy(from, to, last, out);
+  return true;
+}
+
+void SensorHistory::Keys(std::vector<std::string>& out) const {
+  std::shared_lock lock(mutex_);
+  for (auto const& [key, s] : series_) {
+    if (s.samples.size() != 0 || !s.rollups.empty())
+      out.push_back(key);
+  }
+}
+}  // namespace core
@@ -0,0 +1,181 @@
+/**
+ * Widget Sensors
+ * Sensor history
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/gorilla.hpp"
+#include "core/snapshot.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+// Recent (time, value) samples of each numeric sensor, fed with every
+// published snapshot, so that a client can draw a graph right away. Samples
+// are kept compressed, see GorillaBlock, and each sensor keeps at least
+// |capacity| of them, older ones being dropped a block at a time.
+// Longer windows are served by rollups: min, max, mean and count of the
+// samples in fixed time buckets, kept at a few resolutions and updated as
+// samples arrive. Snapshots are only published when something changed, so
+// a value is taken to hold until the next snapshot: the mean is weighted by
+// time, and a bucket the value spans without a new sample still gets it.
+// Sensors missing from the snapshots for longer than the coarsest rollup
+// covers are dropped.
+// Add() must be called from a single thread, queries from any thread.
+class SensorHistory {
+public:
+  using Sample = TimedValue;
+
+  struct Bucket {
+    int64_t time{};  // Start of the bucket
+    double sum{};    // Values times the milliseconds they held
+    float min{};
+    float max{};
+    uint32_t count{};     // Samples taken in the bucket
+    uint32_t duration{};  // Milliseconds of |sum|
+
+    // A bucket whose samples were all taken at the same time has no
+    // duration yet.
+    [[nodiscard]] double mean() const {
+      return duration != 0 ? sum / duration : (double{ min } + max) / 2;
+    }
+  };
+
+  // Rollup resolution in milliseconds and number of buckets kept.
+  struct Level {
+    int64_t resolution{};
+    size_t buckets{};
+  };
+
+  // 10 minutes at 1 s, 1 hour at 10 s, 24 hours at 1 min and 7 days at
+  // 10 min.
+  static std::vector<Level> DefaultLevels();
+
+  SensorHistory(size_t capacity, std::vector<Level> levels);
+
+  [[nodiscard]] size_t capacity() const {
+    return capacity_;
+  }
+
+  // Records the numeric sensors of |snapshot|, taken at |time|.
+  void Add(Snapshot const& snapshot, int64_t time);
+
+  // Appends the samples of |key| taken in [from, to] to |out|, oldest first.
+  // A non-zero |last| keeps only the newest |last| of them. Returns false if
+  // |key| has no history.
+  bool Query(std::string_view key,
+      int64_t from,
+      int64_t to,
+      size_t last,
+      std::vector<Sample>& out) const;
+
+  // Same as Query() for the buckets of the finest rollup at least as coarse
+  // as |resolution|, or the coarsest one.
+  bool QueryRollup(std::string_view key,
+      int64_t resolution,
+      int64_t from,
+      int64_t to,
+      size_t last,
+      std::vector<Bucket>& out) const;
+
+  // Resolution QueryRollup() uses for |resolution|, 0 if there are no
+  // rollups.
+  [[nodiscard]] int64_t RollupResolution(int64_t resolution) const;
+
+  // Appends the keys that have samples to |out|.
+  void Keys(std::vector<std::string>& out) const;
+
+private:
+  // Fixed size buffer overwriting its oldest item, allocated on first use.
+  template<typename T>
+  struct Ring {
+    std::vector<T> items;
+    size_t next{};
+    size_t size{};
+
+    void Push(T const& item, size_t capacity) {
+      if (items.empty())
+        items.resize(capacity);
+
+      items[next] = item;
+      next = (next + 1) % items.size();
+      size = std::min(size + 1, items.size());
+    }
+
+    [[nodiscard]] T& newest() {
+      return items[(next + items.size() - 1) % items.size()];
+    }
+
+    // Appends the items whose time is in [from, to], oldest first, keeping
+    // the newest |last| if non-zero.
+    void Copy(int64_t from, int64_t to, size_t last, std::vector<T>& out)
+        const {
+      auto const first = out.size();
+      auto const oldest = (next + items.size() - size) % items.size();
+      for (size_t i = 0; i < size; i++) {
+        auto const& item = items[(oldest + i) % items.size()];
+        if (item.time >= from && item.time <= to)
+          out.push_back(item);
+      }
+
+      if (last != 0 && out.size() - first > last)
+        out.erase(out.begin() + first, out.end() - last);
+    }
+  };
+
+  struct Series {
+    GorillaSeries samples;
+    std::vector<Ring<Bucket>> rollups;
+    int64_t last_time{};  // Time of the last snapshot with the sensor
+    double last_value{};
+    bool has_value{};  // The sensor was a number in that snapshot
+  };
+
+  // Sensors that were not seen for this long are looked for once a minute.
+  static constexpr int64_t kPruneIntervalMs = 60000;
+
+  void Roll(Series& s, int64_t time, double value);
+  void Carry(Series& s, int64_t from, int64_t to, double value);
+  Bucket& GetBucket(Ring<Bucket>& r, Level const& level, int64_t start,
+      double value);
+  void Prune(int64_t time);
+  [[nodiscard]] size_t FindLevel(int64_t resolution) const;
+
+  mutable std::shared_mutex mutex_;
+  size_t capacity_{};
+  std::vector<Level> levels_;
+  int64_t retention_{};  // Time covered by the coarsest rollup
+  int64_t last_add_{};   // Time of the last snapshot
+  int64_t last_prune_{};
+  std::map<std::string, Series, std::less<>> series_;
+  // Series of each entry of the last snapshot, reused while the keys do not
+  // change.
+  uint64_t key_set_hash_{};
+  std::vector<Series*> index_;
+};
+}  // namespace core
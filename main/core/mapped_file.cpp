@@ -0,0 +1,199 @@
+/**
+ * Widget Sensors
+ * Memory-mapped file
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/mapped_file.hpp"
+#if defined(_WIN32)
+#include "shared/platform.hpp"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+MappedFile::~MappedFile() {
+  Close(size_);
+}
+
+#if defined(_WIN32)
+bool MappedFile::Create(std::filesystem::path const& path, size_t size) {
+  Close(size_);
+  file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    return false;
+  }
+
+  auto const size64 = static_cast<uint64_t>(size);
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE,
+      static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+  if (mapping_ != nullptr)
+    data_ = static_cast<char*>(
+        MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, size));
+
+  writable_ = true;
+  size_ = size;
+  if (data_ == nullptr) {
+    Close(0);
+    return false;
+  }
+  return true;
+}
+
+bool MappedFile::OpenRead(std::filesystem::path const& path) {
+  Close(size_);
+  // The file may still be written by the server.
+  file_ = CreateFileW(path.c_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+    Close(0);
+    return false;
+  }
+
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ != nullptr)
+    data_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+  writable_ = false;
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (data_ == nullptr) {
+    Close(0);
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Flush(size_t size) {
+  if (data_ != nullptr && writable_)
+    FlushViewOfFile(data_, size);
+}
+
+void MappedFile::Close(size_t size) {
+  if (data_ != nullptr) {
+    if (writable_)
+      FlushViewOfFile(data_, size);
+    UnmapViewOfFile(data_);
+  }
+
+  if (mapping_ != nullptr)
+    CloseHandle(mapping_);
+
+  if (file_ != nullptr) {
+    if (writable_) {
+      LARGE_INTEGER end{};
+      end.QuadPart = static_cast<LONGLONG>(size);
+      SetFilePointerEx(file_, end, nullptr, FILE_BEGIN);
+      SetEndOfFile(file_);
+      FlushFileBuffers(file_);
+    }
+    CloseHandle(file_);
+  }
+
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+#else
+bool MappedFile::Create(std::filesystem::path const& path, size_t size) {
+  Close(size_);
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+    return false;
+
+  writable_ = true;
+  size_ = size;
+  if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    Close(0);
+    return false;
+  }
+
+  auto const p =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) {
+    Close(0);
+    return false;
+  }
+
+  data_ = static_cast<char*>(p);
+  return true;
+}
+
+bool MappedFile::OpenRead(std::filesystem::path const& path) {
+  Close(size_);
+  fd_ = open(path.c_str(), O_RDONLY);
+  if (fd_ < 0)
+    return false;
+
+  writable_ = false;
+  struct stat st {};
+  if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+    Close(0);
+    return false;
+  }
+
+  size_ = static_cast<size_t>(st.st_size);
+  auto const p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) {
+    Close(0);
+    return false;
+  }
+
+  data_ = static_cast<char*>(p);
+  return true;
+}
+
+void MappedFile::Flush(size_t size) {
+  if (data_ != nullptr && writable_ && size != 0)
+    msync(data_, size, MS_ASYNC);
+}
+
+void MappedFile::Close(size_t size) {
+  if (data_ != nullptr)
+    munmap(data_, size_);
+
+  if (fd_ >= 0) {
+    if (writable_) {
+      static_cast<void>(ftruncate(fd_, static_cast<off_t>(size)));
+      fsync(fd_);
+    }
+    close(fd_);
+  }
+
+  data_ = nullptr;
+  fd_ = -1;
+  size_ = 0;
+}
+#endif
+}  // namespace core
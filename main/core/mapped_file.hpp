@@ -0,0 +1,74 @@
+/**
+ * Widget Sensors
+ * Memory-mapped file
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+namespace core {
+// A file mapped in memory, either created with a fixed size to be written or
+// opened read-only.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  // Creates |path|, or truncates it, as |size| zero bytes.
+  bool Create(std::filesystem::path const& path, size_t size);
+  bool OpenRead(std::filesystem::path const& path);
+
+  // Starts writing the dirty pages in |[0, size)| to disk, without waiting.
+  void Flush(size_t size);
+  // Unmaps the file. A file opened with Create() is truncated to |size| bytes
+  // and flushed to disk.
+  void Close(size_t size);
+
+  [[nodiscard]] bool is_open() const {
+    return data_ != nullptr;
+  }
+
+  [[nodiscard]] char* data() const {
+    return data_;
+  }
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+private:
+  char* data_{};
+  size_t size_{};
+  bool writable_{};
+#if defined(_WIN32)
+  void* file_{};
+  void* mapping_{};
+#else
+  int fd_{ -1 };
+#endif
+};
+}  // namespace core
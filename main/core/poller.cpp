@@ -0,0 +1,171 @@
+/**
+ * Widget Sensors
+ * Parallel source poller
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/poller.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <utility>
+
+namespace core {
+Poller::Poller(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  workers_.reserve(threads);
+  state_->running = threads;
+  for (size_t i = 0; i < threads; i++)
+    workers_.emplace_back([state = state_] { Run(state); });
+}
+
+Poller::~Poller() {
+  std::unique_lock lock(state_->mutex);
+  state_->quit = true;
+  state_->work_cv.notify_all();
+  auto const stopped = state_->done_cv.wait_for(lock, kShutdownTimeout,
+      [&] { return state_->running == 0; });
+  lock.unlock();
+  for (auto& w : workers_) {
+    if (stopped)
+      w.join();
+    else
+      w.detach();
+  }
+}
+
+size_t Poller::Add(std::string name, poll_t poll, clock_t::duration budget) {
+  assert(poll != nullptr);
+
+  std::lock_guard lock(state_->mutex);
+  auto& s = state_->sources.emplace_back();
+  s.name = std::move(name);
+  s.poll = std::move(poll);
+  s.budget = budget;
+  s.fragment = std::make_shared<std::string>();
+  return state_->sources.size() - 1;
+}
+
+void Poller::Poll(std::vector<size_t> const& ids, std::wstring const& profile) {
+  if (ids.empty())
+    return;
+
+  auto const start = clock_t::now();
+  if (profile_ == nullptr || *profile_ != profile)
+    profile_ = std::make_shared<const std::wstring>(profile);
+
+  auto& state = *state_;
+  std::vector<size_t> started;
+  std::unique_lock lock(state.mutex);
+  for (auto const id : ids) {
+    auto& s = state.sources[id];
+    if (s.busy) {
+      // Still stuck in an earlier call.
+      s.stale = true;
+      continue;
+    }
+
+    s.busy = true;
+    state.queue.push_back({ id, profile_ });
+    started.push_back(id);
+  }
+  lock.unlock();
+  state.work_cv.notify_all();
+  lock.lock();
+
+  std::sort(started.begin(), started.end(), [&](size_t a, size_t b) {
+    return state.sources[a].budget < state.sources[b].budget;
+  });
+  for (auto const id : started) {
+    auto& s = state.sources[id];
+    if (!state.done_cv.wait_until(
+            lock, start + s.budget, [&] { return !s.busy; })) {
+      s.stale = true;
+      s.timeouts++;
+    }
+  }
+}
+
+Poller::Result Poller::Get(size_t id) const {
+  std::lock_guard lock(state_->mutex);
+  auto const& s = state_->sources[id];
+  return { s.fragment, s.stale };
+}
+
+std::vector<Poller::Stats> Poller::GetStats() const {
+  std::lock_guard lock(state_->mutex);
+  std::vector<Stats> stats;
+  stats.reserve(state_->sources.size());
+  for (auto const& s : state_->sources)
+    stats.push_back({ s.name, s.stale, s.timeouts, s.failures, s.latency });
+
+  return stats;
+}
+
+void Poller::Run(std::shared_ptr<State> state) {
+  std::unique_lock lock(state->mutex);
+  for (;;) {
+    state->work_cv.wait(
+        lock, [&] { return state->quit || !state->queue.empty(); });
+    if (state->quit) {
+      state->running--;
+      state->done_cv.notify_all();
+      return;
+    }
+
+    auto job = std::move(state->queue.front());
+    state->queue.pop_front();
+    auto& s = state->sources[job.id];
+    auto buffer = std::move(s.spare);
+    if (buffer != nullptr && buffer.use_count() == 1)
+      std::atomic_thread_fence(std::memory_order_acquire);
+    else
+      buffer = std::make_shared<std::string>();
+    lock.unlock();
+
+    auto const start = clock_t::now();
+    bool ok = true;
+    bool answered = false;
+    try {
+      buffer->clear();
+      answered = s.poll(*job.profile, *buffer);
+    } catch (...) {
+      ok = false;
+    }
+    auto const elapsed = clock_t::now() - start;
+
+    lock.lock();
+    s.busy = false;
+    s.latency.Record(elapsed);
+    if (ok && answered) {
+      s.spare = std::exchange(s.fragment, std::move(buffer));
+      s.stale = false;
+    } else {
+      s.spare = std::move(buffer);
+      s.stale = true;
+      if (!ok)
+        s.failures++;
+    }
+    state->done_cv.notify_all();
+  }
+}
+}  // namespace core
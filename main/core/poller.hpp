@@ -0,0 +1,129 @@
+/**
+ * Widget Sensors
+ * Parallel source poller
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/histogram.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace core {
+// Polls sources concurrently on a pool of worker threads. Each poll has a
+// time budget: a source that misses it keeps its last good fragment, marked
+// stale, and the caller moves on. A source is never polled again while a
+// previous call is still running, so each source only runs on one thread at
+// a time.
+class Poller {
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  // How long the destructor waits for running polls. Workers stuck in a
+  // source past that are detached, so a hung plugin cannot block exit.
+  static constexpr auto kShutdownTimeout = std::chrono::seconds(2);
+
+  // Writes the source's JSON members to |out|, which is empty. |profile| is
+  // the profile that was active when the poll started. Returns false if the
+  // source cannot answer right now, e.g. while it is reloaded, in which case
+  // its last fragment is kept and marked stale.
+  using poll_t =
+      std::function<bool(std::wstring const& profile, std::string& out)>;
+
+  struct Result {
+    std::shared_ptr<const std::string> fragment;
+    bool stale{};
+  };
+
+  struct Stats {
+    std::string name;
+    bool stale{};
+    uint64_t timeouts{};
+    uint64_t failures{};
+    LatencyHistogram latency;
+  };
+
+  explicit Poller(size_t threads);
+  ~Poller();
+
+  Poller(Poller const&) = delete;
+  Poller& operator=(Poller const&) = delete;
+
+  // Returns the id of the new source.
+  size_t Add(std::string name, poll_t poll, clock_t::duration budget);
+
+  // Starts polling |ids| and returns once each of them finished or ran out of
+  // its budget.
+  void Poll(std::vector<size_t> const& ids, std::wstring const& profile);
+
+  [[nodiscard]] Result Get(size_t id) const;
+  [[nodiscard]] std::vector<Stats> GetStats() const;
+
+private:
+  struct Source {
+    std::string name;
+    poll_t poll;
+    clock_t::duration budget{};
+    std::shared_ptr<std::string> fragment;
+    // The previous fragment, written into again once nobody reads it, so the
+    // buffers stop growing after a few polls.
+    std::shared_ptr<std::string> spare;
+    bool busy{};
+    bool stale{};
+    uint64_t timeouts{};
+    uint64_t failures{};
+    LatencyHistogram latency;
+  };
+
+  struct Job {
+    size_t id{};
+    std::shared_ptr<const std::wstring> profile;
+  };
+
+  // Shared with the workers, so that a detached one never outlives it.
+  struct State {
+    mutable std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::deque<Job> queue;
+    // Sources are only added before the first poll, a deque keeps references
+    // held by workers valid anyway.
+    std::deque<Source> sources;
+    size_t running{};  // Workers that have not returned yet.
+    bool quit{};
+  };
+
+  static void Run(std::shared_ptr<State> state);
+
+  std::shared_ptr<State> state_ = std::make_shared<State>();
+  std::vector<std::thread> workers_;
+  // Profile handed to the jobs, only replaced when it changes.
+  std::shared_ptr<const std::wstring> profile_;
+};
+}  // namespace core
@@ -0,0 +1,93 @@
+/**
+ * Widget Sensors
+ * Sensor projections
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/projection.hpp"
+#include "shared/json_writer.hpp"
+#include <algorithm>
+
+namespace core {
+Projection::Projection(std::vector<std::string> keys) : keys_(std::move(keys)) {
+}
+
+bool Projection::Contains(std::string_view key) const {
+  return std::binary_search(keys_.begin(), keys_.end(), key, std::less<>());
+}
+
+std::shared_ptr<const std::string> Projection::Get(
+    snapshot_ptr_t const& snapshot) {
+  if (payload_ != nullptr && seq_ == snapshot->seq)
+    return payload_;
+
+  // Rewrite the previous payload in place unless a client still holds it.
+  if (payload_ == nullptr || payload_.use_count() > 1) {
+    auto p = std::make_shared<std::string>();
+    if (payload_ != nullptr)
+      p->reserve(payload_->capacity());
+
+    payload_ = std::move(p);
+  }
+
+  util::JsonWriter writer(*payload_);
+  writer.BeginObject();
+  writer.Key("sensors");
+  writer.BeginObject();
+  for (auto const& e : snapshot->entries) {
+    if (Contains(e.key))
+      writer.RawMembers(e.member);
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  seq_ = snapshot->seq;
+  return payload_;
+}
+
+std::shared_ptr<Projection> ProjectionCache::Find(
+    std::vector<std::string> keys) {
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  std::string id;
+  for (auto const& k : keys) {
+    id.append(k);
+    id.push_back('\n');
+  }
+
+  for (auto it = projections_.begin(); it != projections_.end();) {
+    if (it->second.expired())
+      it = projections_.erase(it);
+    else
+      ++it;
+  }
+
+  auto& entry = projections_[id];
+  if (auto p = entry.lock())
+    return p;
+
+  auto p = std::make_shared<Projection>(std::move(keys));
+  entry = p;
+  return p;
+}
+}  // namespace core
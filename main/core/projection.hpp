@@ -0,0 +1,65 @@
+/**
+ * Widget Sensors
+ * Sensor projections
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/snapshot.hpp"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+// A subset of the sensors in a snapshot, e.g. { "rtss=>framerate" }. The
+// serialized projection is built at most once per snapshot and shared by all
+// the clients that asked for the same set of keys.
+class Projection {
+public:
+  explicit Projection(std::vector<std::string> keys);
+
+  [[nodiscard]] std::shared_ptr<const std::string> Get(
+      snapshot_ptr_t const& snapshot);
+
+  [[nodiscard]] bool Contains(std::string_view key) const;
+
+  [[nodiscard]] std::vector<std::string> const& keys() const {
+    return keys_;
+  }
+
+private:
+  std::vector<std::string> keys_;
+  uint64_t seq_{};
+  std::shared_ptr<std::string> payload_;
+};
+
+// Interns projections so that identical key sets map to the same instance.
+// Not thread safe, meant to be used from the websocket server thread.
+class ProjectionCache {
+public:
+  [[nodiscard]] std::shared_ptr<Projection> Find(std::vector<std::string> keys);
+
+private:
+  std::map<std::string, std::weak_ptr<Projection>> projections_;
+};
+}  // namespace core
@@ -0,0 +1,119 @@
+/**
+ * Widget Sensors
+ * Session recorder
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/recorder.hpp"
+
+namespace core {
+SessionRecorder::SessionRecorder(std::filesystem::path dir,
+    size_t segment_size,
+    std::chrono::milliseconds flush_interval)
+    : writer_(std::move(dir), segment_size), flush_interval_(flush_interval) {
+}
+
+SessionRecorder::~SessionRecorder() {
+  Stop();
+}
+
+void SessionRecorder::Start() {
+  if (thread_.joinable())
+    return;
+
+  quit_ = false;
+  thread_ = std::thread(&SessionRecorder::Run, this);
+}
+
+void SessionRecorder::Stop() {
+  if (!thread_.joinable())
+    return;
+
+  {
+    std::lock_guard lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void SessionRecorder::Add(snapshot_ptr_t snapshot, int64_t time) {
+  {
+    std::lock_guard lock(mutex_);
+    if (queue_.size() == kMaxQueued) {
+      queue_.pop_front();
+      dropped_++;
+    }
+    queue_.emplace_back(std::move(snapshot), time);
+  }
+  cv_.notify_one();
+}
+
+void SessionRecorder::Run() {
+  using clock_t = std::chrono::steady_clock;
+  Chunk chunk;
+  clock_t::time_point chunk_start;
+  std::deque<std::pair<snapshot_ptr_t, int64_t>> pending;
+  const auto write_chunk = [&] {
+    if (chunk.frames() != 0) {
+      static_cast<void>(writer_.Write(chunk));
+      writer_.Flush();
+    }
+    chunk.Clear();
+  };
+
+  bool quit = false;
+  while (!quit) {
+    {
+      std::unique_lock lock(mutex_);
+      auto const deadline = chunk.frames() != 0
+                                ? chunk_start + flush_interval_
+                                : clock_t::now() + flush_interval_;
+      cv_.wait_until(lock, deadline, [&] { return quit_ || !queue_.empty(); });
+      quit = quit_;
+      pending.swap(queue_);
+    }
+
+    // Snapshots are released as soon as they are in the chunk, so the
+    // snapshot store can reuse their buffers.
+    for (auto& [snapshot, time] : pending) {
+      if (!chunk.Add(*snapshot, time)) {
+        write_chunk();
+        static_cast<void>(chunk.Add(*snapshot, time));
+      }
+      snapshot.reset();
+
+      if (chunk.frames() == 1)
+        chunk_start = clock_t::now();
+      if (chunk.frames() == kChunkFrames)
+        write_chunk();
+    }
+    pending.clear();
+
+    if (quit || (chunk.frames() != 0 &&
+                    clock_t::now() - chunk_start >= flush_interval_))
+      write_chunk();
+  }
+
+  writer_.Close();
+}
+}  // namespace core
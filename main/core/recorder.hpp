@@ -0,0 +1,81 @@
+/**
+ * Widget Sensors
+ * Session recorder
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/recording.hpp"
+#include "core/snapshot.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace core {
+// Records published snapshots to segment files, see recording.hpp. Chunks are
+// built and written by a background thread, so Add() never waits for the
+// disk. A chunk is written once it has kChunkFrames frames, when the sensors
+// change, or |flush_interval| after its first frame.
+class SessionRecorder {
+public:
+  static constexpr size_t kChunkFrames = 64;
+  // Snapshots waiting for the writer. Older ones are dropped beyond this.
+  static constexpr size_t kMaxQueued = 256;
+
+  SessionRecorder(std::filesystem::path dir,
+      size_t segment_size,
+      std::chrono::milliseconds flush_interval);
+  ~SessionRecorder();
+
+  SessionRecorder(SessionRecorder const&) = delete;
+  SessionRecorder& operator=(SessionRecorder const&) = delete;
+
+  void Start();
+  // Writes what is still queued and closes the segment.
+  void Stop();
+
+  // Queues |snapshot|, taken at |time| in milliseconds since the epoch.
+  void Add(snapshot_ptr_t snapshot, int64_t time);
+
+  [[nodiscard]] uint64_t dropped() const {
+    return dropped_;
+  }
+
+private:
+  void Run();
+
+  SegmentWriter writer_;
+  std::chrono::milliseconds flush_interval_{};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::pair<snapshot_ptr_t, int64_t>> queue_;
+  bool quit_{};
+  std::atomic<uint64_t> dropped_{};
+  std::thread thread_;
+};
+}  // namespace core
@@ -0,0 +1,322 @@
+/**
+ * Widget Sensors
+ * Session recording format
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/recording.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+namespace core {
+namespace {
+template<typename T>
+void Put(std::string& out, T const& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutString(std::string& out, std::string_view s) {
+  auto const size = static_cast<uint16_t>(
+      std::min<size_t>(s.size(), std::numeric_limits<uint16_t>::max()));
+  Put(out, size);
+  out.append(s.data(), size);
+}
+
+class PayloadReader {
+public:
+  explicit PayloadReader(std::string_view data) : data_(data) {
+  }
+
+  template<typename T>
+  bool Get(T& value) {
+    if (data_.size() - pos_ < sizeof(value))
+      return false;
+
+    std::memcpy(&value, data_.data() + pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return true;
+  }
+
+  bool GetString(std::string& s) {
+    uint16_t size;
+    if (!Get(size) || data_.size() - pos_ < size)
+      return false;
+
+    s.assign(data_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+private:
+  std::string_view data_;
+  size_t pos_{};
+};
+}  // namespace
+
+uint32_t Crc32(std::string_view data) {
+  static auto const table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < t.size(); i++) {
+      auto c = i;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  uint32_t crc = 0xffffffff;
+  for (auto const ch : data)
+    crc = table[(crc ^ static_cast<uint8_t>(ch)) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffffffff;
+}
+
+void Chunk::Clear() {
+  times.clear();
+  columns.clear();
+  key_set_hash = 0;
+}
+
+bool Chunk::Add(Snapshot const& snapshot, int64_t time) {
+  if (times.empty()) {
+    columns.clear();
+    key_set_hash = snapshot.key_set_hash;
+    for (auto const& e : snapshot.entries) {
+      auto& c = columns.emplace_back();
+      c.key = e.key;
+      c.label = e.label;
+      c.unit = UnitOf(e);
+      double number;
+      c.type = ToNumber(e, number) ? ColumnType::kNumber : ColumnType::kText;
+    }
+  } else if (snapshot.key_set_hash != key_set_hash ||
+             snapshot.entries.size() != columns.size()) {
+    return false;
+  }
+
+  times.push_back(time);
+  for (size_t i = 0; i < columns.size(); i++) {
+    auto& c = columns[i];
+    auto const& e = snapshot.entries[i];
+    if (c.type == ColumnType::kNumber) {
+      double number;
+      if (!ToNumber(e, number))
+        number = std::numeric_limits<double>::quiet_NaN();
+      c.numbers.push_back(number);
+    }
+    // Texts are stored with a 16-bit length, anything longer would come back
+    // cut and no longer be JSON.
+    if (e.value.size() <= std::numeric_limits<uint16_t>::max())
+      c.texts.emplace_back(e.value);
+    else
+      c.texts.emplace_back("null");
+  }
+  return true;
+}
+
+void Chunk::Serialize(std::string& out) const {
+  Put(out, static_cast<uint32_t>(times.size()));
+  Put(out, static_cast<uint32_t>(columns.size()));
+  out.append(reinterpret_cast<const char*>(times.data()),
+      times.size() * sizeof(int64_t));
+  for (auto const& c : columns) {
+    PutString(out, c.key);
+    PutString(out, c.label);
+    PutString(out, c.unit);
+    Put(out, c.type);
+    if (c.type == ColumnType::kNumber) {
+      out.append(reinterpret_cast<const char*>(c.numbers.data()),
+          c.numbers.size() * sizeof(double));
+    }
+
+    // Most sensors are sampled less often than snapshots are published, so
+    // their text is mostly the same as in the previous frame.
+    for (size_t i = 0; i < c.texts.size(); i++)
+      PutString(out, i > 0 && c.texts[i] == c.texts[i - 1] ? "" : c.texts[i]);
+  }
+}
+
+bool Chunk::Parse(std::string_view payload) {
+  Clear();
+  PayloadReader reader(payload);
+  uint32_t frame_count, column_count;
+  if (!reader.Get(frame_count) || !reader.Get(column_count) ||
+      frame_count > payload.size() || column_count > payload.size())
+    return false;
+
+  times.resize(frame_count);
+  for (auto& t : times) {
+    if (!reader.Get(t))
+      return false;
+  }
+
+  columns.resize(column_count);
+  for (auto& c : columns) {
+    if (!reader.GetString(c.key) || !reader.GetString(c.label) ||
+        !reader.GetString(c.unit) || !reader.Get(c.type))
+      return false;
+
+    if (c.type == ColumnType::kNumber) {
+      c.numbers.resize(frame_count);
+      for (auto& n : c.numbers) {
+        if (!reader.Get(n))
+          return false;
+      }
+    } else if (c.type != ColumnType::kText) {
+      return false;
+    }
+
+    c.texts.resize(frame_count);
+    for (size_t i = 0; i < c.texts.size(); i++) {
+      if (!reader.GetString(c.texts[i]))
+        return false;
+      if (i > 0 && c.texts[i].empty())
+        c.texts[i] = c.texts[i - 1];
+    }
+  }
+  return true;
+}
+
+SegmentWriter::SegmentWriter(std::filesystem::path dir, size_t segment_size)
+    : dir_(std::move(dir)), segment_size_(segment_size) {
+}
+
+SegmentWriter::~SegmentWriter() {
+  Close();
+}
+
+bool SegmentWriter::OpenSegment(int64_t time, size_t min_size) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+
+  auto const name = "session-" + std::to_string(time);
+  auto path = dir_ / (name + kSegmentExtension);
+  for (int i = 1; std::filesystem::exists(path, ec); i++)
+    path = dir_ / (name + "-" + std::to_string(i) + kSegmentExtension);
+
+  if (!file_.Create(path,
+          std::max(segment_size_, min_size + sizeof(kSegmentMagic))))
+    return false;
+
+  std::memcpy(file_.data(), kSegmentMagic, sizeof(kSegmentMagic));
+  used_ = sizeof(kSegmentMagic);
+  return true;
+}
+
+bool SegmentWriter::Write(Chunk const& chunk) {
+  if (chunk.frames() == 0)
+    return true;
+
+  payload_.clear();
+  chunk.Serialize(payload_);
+  auto const size = sizeof(ChunkHeader) + payload_.size();
+  if (!file_.is_open() || file_.size() - used_ < size) {
+    Close();
+    if (!OpenSegment(chunk.times.front(), size))
+      return false;
+  }
+
+  // The header goes in last, with its magic after everything else, so that a
+  // reader never sees a chunk that is not complete.
+  auto* const p = file_.data() + used_;
+  std::memcpy(p + sizeof(ChunkHeader), payload_.data(), payload_.size());
+  ChunkHeader header;
+  header.size = static_cast<uint32_t>(payload_.size());
+  header.crc = Crc32(payload_);
+  header.frames = static_cast<uint32_t>(chunk.frames());
+  header.first_time = chunk.times.front();
+  header.last_time = chunk.times.back();
+  std::memcpy(p, &header, sizeof(header));
+  std::atomic_thread_fence(std::memory_order_release);
+  auto const magic = Chunk::kMagic;
+  std::memcpy(p, &magic, sizeof(magic));
+  used_ += size;
+  return true;
+}
+
+void SegmentWriter::Flush() {
+  file_.Flush(used_);
+}
+
+void SegmentWriter::Close() {
+  if (file_.is_open())
+    file_.Close(used_);
+  used_ = 0;
+}
+
+bool SegmentReader::Open(std::filesystem::path const& path) {
+  index_.clear();
+  if (!file_.OpenRead(path) || file_.size() < sizeof(kSegmentMagic) ||
+      std::memcmp(file_.data(), kSegmentMagic, sizeof(kSegmentMagic)) != 0)
+    return false;
+
+  // Chunks follow each other until the zeroes left at the end of a segment,
+  // or a chunk that was not completely written.
+  auto offset = sizeof(kSegmentMagic);
+  while (file_.size() - offset >= sizeof(ChunkHeader)) {
+    Entry e;
+    e.offset = offset;
+    std::memcpy(&e.header, file_.data() + offset, sizeof(ChunkHeader));
+    if (e.header.magic != Chunk::kMagic ||
+        file_.size() - offset - sizeof(ChunkHeader) < e.header.size)
+      break;
+
+    offset += sizeof(ChunkHeader) + e.header.size;
+    index_.push_back(e);
+  }
+  return true;
+}
+
+size_t SegmentReader::Seek(int64_t time) const {
+  auto const it = std::lower_bound(index_.begin(), index_.end(), time,
+      [](auto&& e, int64_t t) { return e.header.last_time < t; });
+  return static_cast<size_t>(it - index_.begin());
+}
+
+bool SegmentReader::Read(size_t i, Chunk& chunk) const {
+  if (i >= index_.size())
+    return false;
+
+  auto const& e = index_[i];
+  std::string_view const payload(
+      file_.data() + e.offset + sizeof(ChunkHeader), e.header.size);
+  return Crc32(payload) == e.header.crc && chunk.Parse(payload);
+}
+
+std::vector<std::filesystem::path> ListSegments(
+    std::filesystem::path const& dir) {
+  std::vector<std::filesystem::path> segments;
+  std::error_code ec;
+  for (auto const& e : std::filesystem::directory_iterator(dir, ec)) {
+    if (e.is_regular_file(ec) && e.path().extension() == kSegmentExtension)
+      segments.push_back(e.path());
+  }
+
+  // Names hold the time of the first frame, which has the same number of
+  // digits for centuries, so they sort by time.
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+}  // namespace core
@@ -0,0 +1,151 @@
+/**
+ * Widget Sensors
+ * Session recording format
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/mapped_file.hpp"
+#include "core/snapshot.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+// Recorded sessions are stored in segment files of a fixed size:
+//   segment: "WSREC002", then chunks until one with a zero magic
+//   chunk:   ChunkHeader, then the payload
+//   payload: frame count u32, column count u32, times i64[frames], then for
+//            each column its key, label and unit as u16 length + bytes, its
+//            type u8, f64[frames] for numbers, and the value text of each
+//            frame as u16 length + bytes, with a zero length for a text
+//            that is the same as the previous frame's.
+// Labels and value texts are raw JSON, the value text being the sensor's
+// value as it was published. All integers are little-endian.
+// The magic of a chunk is written last, and its payload has a checksum, so
+// a crash at worst loses the chunk being written.
+constexpr char kSegmentMagic[8] = { 'W', 'S', 'R', 'E', 'C', '0', '0', '2' };
+constexpr char kSegmentExtension[] = ".wsrec";
+
+struct ChunkHeader {
+  uint32_t magic{};
+  uint32_t size{};  // Payload bytes
+  uint32_t crc{};   // CRC-32 of the payload
+  uint32_t frames{};
+  int64_t first_time{};
+  int64_t last_time{};
+};
+
+enum class ColumnType : uint8_t { kNumber, kText };
+
+// Consecutive snapshots with the same sensors, stored by column.
+struct Chunk {
+  static constexpr uint32_t kMagic = 0x4b435357;  // "WSCK"
+
+  struct Column {
+    std::string key;
+    std::string label;
+    std::string unit;
+    ColumnType type{};
+    std::vector<double> numbers;     // kNumber columns only
+    std::vector<std::string> texts;  // Value text of every frame
+  };
+
+  std::vector<int64_t> times;  // Milliseconds since the epoch
+  std::vector<Column> columns;
+  uint64_t key_set_hash{};
+
+  [[nodiscard]] size_t frames() const {
+    return times.size();
+  }
+
+  void Clear();
+
+  // Appends |snapshot|, taken at |time|, as a frame. Returns false, leaving
+  // the chunk as it was, if its sensors are not the ones of the chunk.
+  bool Add(Snapshot const& snapshot, int64_t time);
+
+  void Serialize(std::string& out) const;
+  bool Parse(std::string_view payload);
+};
+
+uint32_t Crc32(std::string_view data);
+
+// Appends chunks to segment files named after the time of their first
+// frame, starting a new segment when the current one is full.
+class SegmentWriter {
+public:
+  SegmentWriter(std::filesystem::path dir, size_t segment_size);
+  ~SegmentWriter();
+
+  SegmentWriter(SegmentWriter const&) = delete;
+  SegmentWriter& operator=(SegmentWriter const&) = delete;
+
+  bool Write(Chunk const& chunk);
+  // Starts writing what was appended so far to disk.
+  void Flush();
+  void Close();
+
+private:
+  bool OpenSegment(int64_t time, size_t min_size);
+
+  std::filesystem::path dir_;
+  size_t segment_size_{};
+  MappedFile file_;
+  size_t used_{};
+  std::string payload_;
+};
+
+// Reads the chunks of a segment file, which can be still being written.
+class SegmentReader {
+public:
+  bool Open(std::filesystem::path const& path);
+
+  [[nodiscard]] size_t chunk_count() const {
+    return index_.size();
+  }
+
+  [[nodiscard]] ChunkHeader const& header(size_t i) const {
+    return index_[i].header;
+  }
+
+  // Index of the first chunk with frames at or after |time|, chunk_count()
+  // if there is none.
+  [[nodiscard]] size_t Seek(int64_t time) const;
+  bool Read(size_t i, Chunk& chunk) const;
+
+private:
+  struct Entry {
+    size_t offset{};
+    ChunkHeader header;
+  };
+
+  MappedFile file_;
+  std::vector<Entry> index_;
+};
+
+// Segment files of |dir|, oldest first.
+std::vector<std::filesystem::path> ListSegments(
+    std::filesystem::path const& dir);
+}  // namespace core
@@ -0,0 +1,163 @@
+/**
+ * Widget Sensors
+ * Session replay
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/replay.hpp"
+#include "shared/json_writer.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+
+namespace core {
+namespace {
+// Reads the "time" member of a capture line, skipping everything else.
+bool ParseCaptureLine(std::string const& line, int64_t& time) {
+  try {
+    auto const json = nlohmann::json::parse(line,
+        [](int depth, nlohmann::json::parse_event_t event, auto&& parsed) {
+          return depth != 1 || event != nlohmann::json::parse_event_t::key ||
+                 parsed == "time";
+        });
+    if (!json.is_object())
+      return false;
+
+    if (json.contains("time") && json["time"].is_number_integer())
+      time = json["time"].get<int64_t>();
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+}  // namespace
+
+bool ReplayReader::Open(std::filesystem::path const& path) {
+  path_ = path;
+  segments_.clear();
+  segment_ = 0;
+  static_cast<void>(reader_.Open({}));
+  chunk_ = 0;
+  current_.Clear();
+  frame_ = 0;
+  capture_.close();
+  last_time_ = -kCaptureIntervalMs;
+
+  std::error_code ec;
+  if (std::filesystem::is_directory(path, ec)) {
+    segments_ = ListSegments(path);
+    return !segments_.empty();
+  }
+
+  if (path.extension() == kSegmentExtension) {
+    segments_.push_back(path);
+    return std::filesystem::exists(path, ec);
+  }
+
+  capture_.open(path, std::ios::binary);
+  return capture_.is_open();
+}
+
+bool ReplayReader::Rewind() {
+  return Open(std::filesystem::path(path_));
+}
+
+bool ReplayReader::Next(ReplayFrame& frame) {
+  if (capture_.is_open())
+    return NextLine(frame);
+
+  if (frame_ >= current_.frames() && !NextChunk())
+    return false;
+
+  frame.time = current_.times[frame_];
+  WriteSnapshot(current_, frame_, frame.data);
+  frame_++;
+  return true;
+}
+
+bool ReplayReader::NextChunk() {
+  frame_ = 0;
+  for (;;) {
+    // Chunks that fail their checksum are skipped.
+    while (chunk_ < reader_.chunk_count()) {
+      if (reader_.Read(chunk_++, current_) && current_.frames() > 0)
+        return true;
+    }
+
+    if (segment_ >= segments_.size())
+      return false;
+
+    chunk_ = 0;
+    static_cast<void>(reader_.Open(segments_[segment_++]));
+  }
+}
+
+bool ReplayReader::NextLine(ReplayFrame& frame) {
+  while (std::getline(capture_, frame.data)) {
+    if (!frame.data.empty() && frame.data.back() == '\r')
+      frame.data.pop_back();
+
+    auto time = last_time_ + kCaptureIntervalMs;
+    if (!ParseCaptureLine(frame.data, time))
+      continue;
+
+    frame.time = last_time_ = time;
+    return true;
+  }
+  return false;
+}
+
+void WriteSnapshot(Chunk const& chunk, size_t frame, std::string& out) {
+  util::JsonWriter writer(out);
+  writer.BeginObject();
+  writer.Key("sensors");
+  writer.BeginObject();
+  for (auto const& c : chunk.columns) {
+    writer.RawKey(c.key);
+    if (c.texts[frame].empty())
+      writer.Null();
+    else
+      writer.RawValue(c.texts[frame]);
+  }
+  writer.EndObject();
+  writer.EndObject();
+}
+
+ReplayClock::ReplayClock(double speed) : speed_(std::max(speed, 0.0)) {
+}
+
+ReplayClock::clock_t::time_point ReplayClock::Due(int64_t time) {
+  auto const now = clock_t::now();
+  if (!started_ || time < last_time_ || time - last_time_ > kMaxGapMs) {
+    started_ = true;
+    start_ = now;
+    first_time_ = time;
+  }
+  last_time_ = time;
+
+  if (speed_ == 0.0)
+    return now;
+
+  auto const elapsed =
+      std::chrono::duration<double, std::milli>((time - first_time_) / speed_);
+  return start_ + std::chrono::duration_cast<clock_t::duration>(elapsed);
+}
+}  // namespace core
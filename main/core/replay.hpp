@@ -0,0 +1,103 @@
+/**
+ * Widget Sensors
+ * Session replay
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/recording.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace core {
+struct ReplayFrame {
+  int64_t time{};  // Milliseconds since the epoch
+  std::string data;  // Snapshot JSON, as sent to clients
+};
+
+// Reads back the snapshots of a session, oldest first, from a segment file,
+// a directory of segments such as the recordings directory, or a JSON-lines
+// capture with one snapshot per line. A capture line may have a "time"
+// member in milliseconds since the epoch, lines without one come
+// kCaptureIntervalMs after the previous line.
+// Capture lines are replayed verbatim. Recorded frames are rebuilt from
+// their columns, with the same text as the snapshot they were taken from.
+class ReplayReader {
+public:
+  static constexpr int64_t kCaptureIntervalMs = 250;
+
+  bool Open(std::filesystem::path const& path);
+  // Starts over from the first frame.
+  bool Rewind();
+  // Returns false at the end of the session.
+  bool Next(ReplayFrame& frame);
+
+private:
+  bool NextChunk();
+  bool NextLine(ReplayFrame& frame);
+
+  std::filesystem::path path_;
+  std::vector<std::filesystem::path> segments_;
+  size_t segment_{};
+  SegmentReader reader_;
+  size_t chunk_{};
+  Chunk current_;
+  size_t frame_{};
+  std::ifstream capture_;
+  int64_t last_time_{};
+};
+
+// Writes frame |frame| of |chunk| as snapshot JSON to |out|.
+void WriteSnapshot(Chunk const& chunk, size_t frame, std::string& out);
+
+// Paces frames on their recorded times, |speed| times faster than they were
+// recorded, or as fast as possible when |speed| is 0. Recorded gaps longer
+// than kMaxGapMs, e.g. between two sessions, and times going backwards, e.g.
+// when a replay starts over, are skipped.
+class ReplayClock {
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  static constexpr int64_t kMaxGapMs = 5000;
+
+  explicit ReplayClock(double speed);
+
+  // Time at which the frame recorded at |time| is due. Must be called for
+  // every frame, in order.
+  clock_t::time_point Due(int64_t time);
+
+  [[nodiscard]] double speed() const {
+    return speed_;
+  }
+
+private:
+  double speed_{};
+  clock_t::time_point start_;
+  int64_t first_time_{};
+  int64_t last_time_{};
+  bool started_{};
+};
+}  // namespace core
@@ -0,0 +1,64 @@
+/**
+ * Widget Sensors
+ * Sampling scheduler
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/scheduler.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace core {
+size_t Scheduler::Add(std::string name, clock_t::duration period) {
+  assert(period > clock_t::duration::zero());
+
+  deadlines_.push_back(clock_t::now());
+  stats_.push_back({ std::move(name), period });
+  return stats_.size() - 1;
+}
+
+Scheduler::clock_t::time_point Scheduler::NextDeadline() const {
+  if (deadlines_.empty())
+    return clock_t::time_point::max();
+
+  return *std::min_element(deadlines_.begin(), deadlines_.end());
+}
+
+void Scheduler::Collect(clock_t::time_point now, std::vector<size_t>& due) {
+  due.clear();
+  for (size_t i = 0; i < deadlines_.size(); i++) {
+    auto& deadline = deadlines_[i];
+    if (deadline > now)
+      continue;
+
+    auto& s = stats_[i];
+    auto const late = now - deadline;
+    auto const missed = late / s.period;
+    s.ticks++;
+    s.overruns += missed;
+    s.jitter = late % s.period;
+    s.max_jitter = std::max(s.max_jitter, s.jitter);
+    deadline += (missed + 1) * s.period;
+    due.push_back(i);
+  }
+}
+}  // namespace core
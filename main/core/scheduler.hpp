@@ -0,0 +1,68 @@
+/**
+ * Widget Sensors
+ * Sampling scheduler
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace core {
+// Runs sampling sources, each at its own period, against absolute deadlines
+// on the monotonic clock. A source that falls behind skips the periods it
+// missed and counts them as overruns rather than running back to back.
+// Not thread safe, meant to be driven by the sampling thread.
+class Scheduler {
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  struct Stats {
+    std::string name;
+    clock_t::duration period{};
+    uint64_t ticks{};
+    uint64_t overruns{};
+    // How late the last and the worst tick ran past their deadline.
+    clock_t::duration jitter{};
+    clock_t::duration max_jitter{};
+  };
+
+  // Returns the id of the new source. It is due right away.
+  size_t Add(std::string name, clock_t::duration period);
+
+  [[nodiscard]] clock_t::time_point NextDeadline() const;
+
+  // Fills |due| with the ids of the sources due at |now| and moves their
+  // deadlines to the next period.
+  void Collect(clock_t::time_point now, std::vector<size_t>& due);
+
+  [[nodiscard]] std::vector<Stats> const& stats() const {
+    return stats_;
+  }
+
+private:
+  std::vector<clock_t::time_point> deadlines_;
+  std::vector<Stats> stats_;
+};
+}  // namespace core
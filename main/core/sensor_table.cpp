@@ -0,0 +1,193 @@
+/**
+ * Widget Sensors
+ * Typed sensor table
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/sensor_table.hpp"
+#include "shared/json_writer.hpp"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace core {
+namespace {
+// Compares the bit patterns, so that setting NaN again is not a change.
+bool SameNumber(double a, double b) {
+  return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+}  // namespace
+
+SensorTable::id_t SensorTable::Add(uint32_t owner,
+    std::string_view key,
+    std::string_view label,
+    std::string_view unit,
+    SensorType type) {
+  std::lock_guard lock(mutex_);
+  id_t id = 0;
+  for (; id < sensors_.size(); id++) {
+    if (sensors_[id].owner == owner && sensors_[id].key == key)
+      break;
+  }
+
+  if (id == sensors_.size()) {
+    if (id == kInvalidId)
+      return kInvalidId;
+
+    auto& s = sensors_.emplace_back();
+    s.owner = owner;
+    s.key = key;
+  }
+
+  auto& s = sensors_[id];
+  s.label = label;
+  s.unit = unit;
+  s.type = type;
+  s.dirty = true;
+  return id;
+}
+
+void SensorTable::SetNumber(id_t id, double value) {
+  std::lock_guard lock(mutex_);
+  auto* s = Find(id);
+  if (s == nullptr)
+    return;
+
+  if (s->type == SensorType::kInteger)
+    value = std::round(value);
+  else if (s->type == SensorType::kBool)
+    value = value != 0.0 ? 1.0 : 0.0;
+  else if (s->type == SensorType::kString)
+    return;
+
+  if (s->has_value && SameNumber(s->number, value))
+    return;
+
+  s->number = value;
+  s->has_value = true;
+  s->dirty = true;
+}
+
+void SensorTable::SetBool(id_t id, bool value) {
+  SetNumber(id, value ? 1.0 : 0.0);
+}
+
+void SensorTable::SetString(id_t id, std::string_view value) {
+  std::lock_guard lock(mutex_);
+  auto* s = Find(id);
+  if (s == nullptr || s->type != SensorType::kString)
+    return;
+
+  if (s->has_value && s->text == value)
+    return;
+
+  s->text = value;
+  s->has_value = true;
+  s->dirty = true;
+}
+
+void SensorTable::Write(uint32_t owner, std::string& out) {
+  std::lock_guard lock(mutex_);
+  for (auto& s : sensors_) {
+    if (s.owner != owner || !s.has_value)
+      continue;
+
+    if (s.dirty)
+      Serialize(s);
+
+    if (!out.empty())
+      out.push_back(',');
+
+    out.append(s.member);
+  }
+}
+
+std::optional<bool> SensorTable::IsDemanded(uint32_t owner,
+    DemandTracker::Demand const& demand) {
+  std::lock_guard lock(mutex_);
+  std::optional<bool> demanded;
+  for (auto const& s : sensors_) {
+    if (s.owner != owner)
+      continue;
+
+    if (demand.Reads(s.key))
+      return true;
+
+    demanded = false;
+  }
+  return demanded;
+}
+
+SensorTable::Sensor* SensorTable::Find(id_t id) {
+  return id < sensors_.size() ? &sensors_[id] : nullptr;
+}
+
+void SensorTable::Serialize(Sensor& s) {
+  s.dirty = false;
+  util::JsonWriter writer(s.member);
+  writer.Key(s.key);
+  writer.BeginObject();
+  writer.Key("sensor");
+  writer.String(s.label);
+  writer.Key("value");
+  switch (s.type) {
+    case SensorType::kBool:
+      writer.Bool(s.number != 0.0);
+      break;
+    case SensorType::kString:
+      writer.String(s.text);
+      break;
+    default: {
+      // Numbers with a unit keep the "value" display text, e.g. "59.9 fps",
+      // the number itself goes to "valueRaw". JSON has no NaN or infinity.
+      if (!std::isfinite(s.number)) {
+        writer.Null();
+        writer.Key("valueRaw");
+        writer.Null();
+        break;
+      }
+
+      std::array<char, 64> buf;
+      auto res = std::to_chars(buf.data(), buf.data() + buf.size(), s.number);
+      std::string_view const number(buf.data(), res.ptr - buf.data());
+      if (s.unit.empty()) {
+        writer.RawValue(number);
+      } else {
+        s.text.assign(number);
+        s.text.push_back(' ');
+        s.text.append(s.unit);
+        writer.String(s.text);
+      }
+      writer.Key("valueRaw");
+      writer.RawValue(number);
+      break;
+    }
+  }
+
+  if (!s.unit.empty()) {
+    writer.Key("unit");
+    writer.String(s.unit);
+  }
+  writer.EndObject();
+}
+}  // namespace core
@@ -0,0 +1,89 @@
+/**
+ * Widget Sensors
+ * Typed sensor table
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "core/demand.hpp"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace core {
+enum class SensorType : uint32_t { kNumber, kInteger, kBool, kString };
+
+// Sensors published as typed values rather than JSON text. Each sensor keeps
+// its serialized member, which is only rebuilt when its value changes.
+// Thread safe, values can be set from any thread.
+class SensorTable {
+public:
+  using id_t = uint32_t;
+  static constexpr id_t kInvalidId = ~id_t{};
+
+  // Adding a key that |owner| already registered returns the existing id,
+  // with |label|, |unit| and |type| updated.
+  id_t Add(uint32_t owner,
+      std::string_view key,
+      std::string_view label,
+      std::string_view unit,
+      SensorType type);
+
+  // Setting a value of the wrong type converts it when possible. Unknown ids
+  // are ignored.
+  void SetNumber(id_t id, double value);
+  void SetBool(id_t id, bool value);
+  void SetString(id_t id, std::string_view value);
+
+  // Appends "key":{...} for each sensor of |owner| that has a value,
+  // separated from any members already in |out| by a comma.
+  void Write(uint32_t owner, std::string& out);
+
+  // Whether |demand| reads a key of |owner|, or std::nullopt if |owner| has
+  // no sensors.
+  [[nodiscard]] std::optional<bool> IsDemanded(uint32_t owner,
+      DemandTracker::Demand const& demand);
+
+private:
+  struct Sensor {
+    uint32_t owner{};
+    std::string key;
+    std::string label;
+    std::string unit;
+    SensorType type{};
+    bool has_value{};
+    bool dirty{};
+    double number{};
+    std::string text;
+    std::string member;  // Serialized "key":{...}
+  };
+
+  Sensor* Find(id_t id);
+  void Serialize(Sensor& s);
+
+  std::mutex mutex_;
+  std::deque<Sensor> sensors_;
+};
+}  // namespace core
@@ -0,0 +1,377 @@
+/**
+ * Widget Sensors
+ * Sensor snapshots
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/snapshot.hpp"
+#include <charconv>
+
+namespace core {
+namespace {
+constexpr auto npos = std::string_view::npos;
+
+size_t SkipWhitespace(std::string_view s, size_t pos) {
+  while (pos < s.size() &&
+         (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\r' || s[pos] == '\n'))
+    pos++;
+
+  return pos;
+}
+
+// |pos| must point to the opening quote. Returns the position after the
+// closing quote.
+size_t SkipString(std::string_view s, size_t pos) {
+  for (pos++; pos < s.size(); pos++) {
+    if (s[pos] == '\\')
+      pos++;
+    else if (s[pos] == '"')
+      return pos + 1;
+  }
+
+  return npos;
+}
+
+size_t SkipValue(std::string_view s, size_t pos) {
+  if (pos >= s.size())
+    return npos;
+
+  if (s[pos] == '"')
+    return SkipString(s, pos);
+
+  if (s[pos] == '{' || s[pos] == '[') {
+    int depth = 0;
+    while (pos < s.size()) {
+      auto const c = s[pos];
+      if (c == '"') {
+        pos = SkipString(s, pos);
+        if (pos == npos)
+          return npos;
+
+        continue;
+      }
+
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0)
+          return pos + 1;
+      }
+      pos++;
+    }
+    return npos;
+  }
+
+  while (pos < s.size() && s[pos] != ',' && s[pos] != '}' && s[pos] != ']' &&
+         s[pos] != ' ' && s[pos] != '\t' && s[pos] != '\r' && s[pos] != '\n')
+    pos++;
+
+  return pos;
+}
+
+// Calls |fn(key, member, value)| for each member from |pos| on, up to the
+// closing brace of the object or, for a |run| of members as in a plugin
+// fragment, to the end of |s|. Stops early when |fn| returns false.
+template<typename Fn>
+bool ForEachMemberFrom(std::string_view s, size_t pos, bool run, Fn&& fn) {
+  pos = SkipWhitespace(s, pos);
+  if (pos >= s.size())
+    return run;
+
+  if (!run && s[pos] == '}')
+    return true;
+
+  while (pos < s.size()) {
+    if (s[pos] != '"')
+      return false;
+
+    auto const member_start = pos;
+    auto const key_end = SkipString(s, pos);
+    if (key_end == npos)
+      return false;
+
+    auto const key = s.substr(pos + 1, key_end - pos - 2);
+    pos = SkipWhitespace(s, key_end);
+    if (pos >= s.size() || s[pos] != ':')
+      return false;
+
+    auto const value_start = SkipWhitespace(s, pos + 1);
+    auto const value_end = SkipValue(s, value_start);
+    if (value_end == npos)
+      return false;
+
+    if (!fn(key, s.substr(member_start, value_end - member_start),
+            s.substr(value_start, value_end - value_start)))
+      return true;
+
+    pos = SkipWhitespace(s, value_end);
+    if (pos >= s.size())
+      return run;
+
+    if (!run && s[pos] == '}')
+      return true;
+
+    if (s[pos] != ',')
+      return false;
+
+    pos = SkipWhitespace(s, pos + 1);
+  }
+  return false;
+}
+
+// Calls |fn(key, member, value)| for each member of the object starting at
+// |pos|. Stops early when |fn| returns false.
+template<typename Fn>
+bool ForEachMember(std::string_view s, size_t pos, Fn&& fn) {
+  pos = SkipWhitespace(s, pos);
+  if (pos >= s.size() || s[pos] != '{')
+    return false;
+
+  return ForEachMemberFrom(s, pos + 1, false, fn);
+}
+
+SensorEntry MakeEntry(std::string_view key,
+    std::string_view member,
+    std::string_view value) {
+  SensorEntry e;
+  e.key = key;
+  e.member = member;
+  e.value = value;
+  e.hash = Fnv1a(value);
+  if (!value.empty() && value[0] == '{') {
+    const auto add_field = [&](auto&& k, auto&&, auto&& v) {
+      if (k == "sensor")
+        e.label = v;
+      else if (k == "value")
+        e.display = v;
+      else if (k == "valueRaw")
+        e.raw = v;
+
+      return true;
+    };
+    static_cast<void>(ForEachMember(value, 0, add_field));
+  }
+  return e;
+}
+
+uint64_t HashKey(std::string_view key, uint64_t hash) {
+  return Fnv1a("\n", Fnv1a(key, hash));
+}
+
+// |view|, which points into |from|, moved to the same place in |to|.
+std::string_view Rebase(std::string_view view,
+    std::string_view from,
+    char const* to) {
+  if (view.empty())
+    return {};
+
+  return { to + (view.data() - from.data()), view.size() };
+}
+
+// Appends the entries of a run of members, which may start with the comma
+// separating it from the members before.
+bool AppendMembers(std::string_view members, std::vector<SensorEntry>& out) {
+  auto pos = SkipWhitespace(members, 0);
+  if (pos < members.size() && members[pos] == ',')
+    pos++;
+
+  return ForEachMemberFrom(members, pos, true,
+      [&](auto&& key, auto&& member, auto&& value) {
+        out.push_back(MakeEntry(key, member, value));
+        return true;
+      });
+}
+}  // namespace
+
+bool IndexMembers(std::string_view members, std::vector<SensorEntry>& out) {
+  out.clear();
+  return AppendMembers(members, out);
+}
+
+bool ToNumber(std::string_view text, double& out, bool strip_unit) {
+  if (strip_unit) {
+    if (auto const p = text.rfind(' '); p != std::string_view::npos)
+      text = text.substr(0, p);
+  }
+
+  // Commas are only taken as digit grouping when a decimal point follows,
+  // as in "3,724.8". Text like "45,5" uses a decimal comma, or is ambiguous
+  // as in "3,724", and is left to "valueRaw".
+  auto const point = text.rfind('.');
+  if (auto const comma = text.find(',');
+      comma != std::string_view::npos &&
+      (!strip_unit || point == std::string_view::npos || point < comma))
+    return false;
+
+  char buf[64];
+  size_t len{};
+  for (auto const c : text) {
+    if (c == ',')
+      continue;
+
+    if (len == sizeof(buf))
+      return false;
+
+    buf[len++] = c;
+  }
+
+  if (len == 0)
+    return false;
+
+  auto const res = std::from_chars(buf, buf + len, out);
+  return res.ec == std::errc() && res.ptr == buf + len;
+}
+
+bool ToNumber(SensorEntry const& e, double& out) {
+  // "valueRaw" is plain number text, only display values carry a unit.
+  auto const has_raw = !e.raw.empty() && e.raw != "\"\"";
+  auto v = has_raw ? e.raw : e.display;
+  if (v.empty())
+    v = e.value;
+
+  if (v == "true" || v == "false") {
+    out = v == "true" ? 1.0 : 0.0;
+    return true;
+  }
+
+  if (v.size() >= 2 && v.front() == '"' && v.back() == '"')
+    return ToNumber(v.substr(1, v.size() - 2), out, !has_raw);
+
+  return ToNumber(v, out, false);
+}
+
+std::string_view UnitOf(SensorEntry const& e) {
+  auto const& d = e.display;
+  if (d.size() < 2 || d.front() != '"' || d.back() != '"')
+    return {};
+
+  auto const text = d.substr(1, d.size() - 2);
+  auto const p = text.rfind(' ');
+  if (p == std::string_view::npos || text.find_first_of("0123456789") > p)
+    return {};
+
+  return text.substr(p + 1);
+}
+
+bool Snapshot::Index() {
+  entries.clear();
+  key_set_hash = Fnv1a({});
+
+  std::string_view const s = data;
+  std::string_view sensors;
+  if (!ForEachMember(s, 0, [&](auto&& key, auto&&, auto&& value) {
+        if (key != "sensors")
+          return true;
+
+        sensors = value;
+        return false;
+      }))
+    return false;
+
+  if (sensors.empty())
+    return false;
+
+  const auto add_entry = [&](auto&& key, auto&& member, auto&& value) {
+    entries.push_back(MakeEntry(key, member, value));
+    key_set_hash = HashKey(key, key_set_hash);
+    return true;
+  };
+  indexed = true;
+  return ForEachMember(sensors, 0, add_entry);
+}
+
+void Snapshot::BeginIndex() {
+  runs_.clear();
+  indexed = false;
+}
+
+void Snapshot::IndexMembers(size_t begin) {
+  runs_.push_back({ begin, data.size(), {}, nullptr });
+}
+
+void Snapshot::AddMembers(size_t begin,
+    std::string_view members,
+    std::vector<SensorEntry> const& index) {
+  runs_.push_back({ begin, begin + members.size(), members, &index });
+}
+
+bool Snapshot::EndIndex() {
+  entries.clear();
+  key_set_hash = Fnv1a({});
+  bool ok = true;
+  for (auto const& run : runs_) {
+    std::string_view const text(data.data() + run.begin, run.end - run.begin);
+    if (run.index == nullptr) {
+      ok = AppendMembers(text, entries) && ok;
+    } else {
+      // Views into the indexed text are moved to where it was copied.
+      for (auto e : *run.index) {
+        e.key = Rebase(e.key, run.members, text.data());
+        e.member = Rebase(e.member, run.members, text.data());
+        e.value = Rebase(e.value, run.members, text.data());
+        e.label = Rebase(e.label, run.members, text.data());
+        e.display = Rebase(e.display, run.members, text.data());
+        e.raw = Rebase(e.raw, run.members, text.data());
+        entries.push_back(e);
+      }
+    }
+  }
+
+  for (auto const& e : entries)
+    key_set_hash = HashKey(e.key, key_set_hash);
+
+  runs_.clear();
+  indexed = true;
+  return ok;
+}
+
+SnapshotStore::SnapshotStore(size_t reserve) : reserve_(reserve) {
+  pool_.reserve(kMaxPoolSize);
+}
+
+std::shared_ptr<Snapshot> SnapshotStore::Acquire() {
+  for (auto& s : pool_) {
+    // The pool holds one reference and the published snapshot holds another,
+    // so a count of one means that nobody can read this buffer anymore.
+    if (s.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s->indexed = false;
+      return s;
+    }
+  }
+
+  auto s = std::make_shared<Snapshot>();
+  s->data.reserve(reserve_);
+  if (pool_.size() < kMaxPoolSize)
+    pool_.push_back(s);
+
+  return s;
+}
+
+void SnapshotStore::Publish(std::shared_ptr<Snapshot> snapshot) {
+  snapshot->seq = ++seq_;
+  if (!snapshot->indexed)
+    static_cast<void>(snapshot->Index());
+  std::atomic_store_explicit(&current_,
+      snapshot_ptr_t(std::move(snapshot)), std::memory_order_release);
+}
+}  // namespace core
@@ -0,0 +1,139 @@
+/**
+ * Widget Sensors
+ * Sensor snapshots
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+inline uint64_t Fnv1a(std::string_view s,
+    uint64_t hash = 0xcbf29ce484222325ull) {
+  for (auto const c : s) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Parses numbers sent as text, e.g. "3724.8". With |strip_unit| set, display
+// values like "3,724.8 MHz" are accepted as well, but not "45,5 °C", whose
+// comma could be a decimal separator.
+bool ToNumber(std::string_view text, double& out, bool strip_unit);
+
+// A member of the "sensors" object. All views point into Snapshot::data.
+struct SensorEntry {
+  std::string_view key;     // Raw key, without quotes.
+  std::string_view member;  // "key":value
+  std::string_view value;
+  uint64_t hash{};  // Hash of |value|, used to detect changes.
+
+  // Fields of |value| when it is a {"sensor":..,"value":..,"valueRaw":..}
+  // object, as raw JSON text. Empty when missing.
+  std::string_view label;
+  std::string_view display;
+  std::string_view raw;
+};
+
+// Indexes |members|, a run of members of the "sensors" object such as a
+// plugin fragment, which may start with a comma. Returns false if it could
+// not be fully parsed, in which case |out| holds the members found so far.
+bool IndexMembers(std::string_view members, std::vector<SensorEntry>& out);
+
+// Numeric value of |e|, taken from "valueRaw" when there is one. Display
+// text with a unit and booleans are converted too.
+bool ToNumber(SensorEntry const& e, double& out);
+
+// Unit of a display value like "3,724.8 MHz", empty if there is none.
+std::string_view UnitOf(SensorEntry const& e);
+
+struct Snapshot {
+  uint64_t seq{};
+  std::string data;
+  std::vector<SensorEntry> entries;
+  uint64_t key_set_hash{};  // Changes when sensors are added or removed.
+  bool indexed{};  // |entries| match |data|, SnapshotStore::Publish() checks
+
+  // Rebuilds |entries| from |data|. Returns false if |data| could not be fully
+  // parsed, in which case |entries| holds the sensors found so far.
+  bool Index();
+
+  // Indexes the snapshot as it is written, so that publishing it does not
+  // parse it all again. Call BeginIndex() first, then after writing each run
+  // of members of the "sensors" object either IndexMembers(), to parse what
+  // was written from offset |begin| of |data| on, or AddMembers() when the
+  // run is a copy, at offset |begin|, of |members| indexed beforehand as
+  // |index|, e.g. a plugin fragment that did not change. |members| and
+  // |index| must stay valid until EndIndex(), which builds |entries| once
+  // |data| is complete.
+  void BeginIndex();
+  void IndexMembers(size_t begin);
+  void AddMembers(size_t begin,
+      std::string_view members,
+      std::vector<SensorEntry> const& index);
+  bool EndIndex();
+
+private:
+  struct Run {
+    size_t begin{};
+    size_t end{};
+    std::string_view members;
+    std::vector<SensorEntry> const* index{};
+  };
+
+  std::vector<Run> runs_;
+};
+
+using snapshot_ptr_t = std::shared_ptr<const Snapshot>;
+
+// Publishes immutable snapshots to readers through an atomic pointer swap.
+// Readers keep the snapshot they got alive for as long as they need it, the
+// sampler never waits for them: buffers still referenced by a reader are just
+// skipped when picking the next one to write into.
+class SnapshotStore {
+public:
+  explicit SnapshotStore(size_t reserve);
+
+  // Returns a buffer that no reader references anymore. Must only be called
+  // from the thread publishing snapshots.
+  [[nodiscard]] std::shared_ptr<Snapshot> Acquire();
+  void Publish(std::shared_ptr<Snapshot> snapshot);
+
+  [[nodiscard]] snapshot_ptr_t Current() const {
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+  }
+
+private:
+  static constexpr size_t kMaxPoolSize = 8;
+
+  std::vector<std::shared_ptr<Snapshot>> pool_;
+  snapshot_ptr_t current_;
+  size_t reserve_{};
+  uint64_t seq_{};
+};
+}  // namespace core
@@ -0,0 +1,134 @@
+/**
+ * Widget Sensors
+ * Shared memory value ring
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/value_ring.hpp"
+#include <cstring>
+
+namespace core {
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+    "ring sequence numbers must be lock free to be shared");
+
+struct ValueRing::Header {
+  std::atomic<uint64_t> write_seq;
+  uint32_t slots;
+  uint32_t slot_size;
+};
+
+// Followed by |slot_size| bytes of data, rounded up to 8 bytes. |seq| is
+// 2 * message + 1 while the message is written and 2 * message once done.
+struct ValueRing::Slot {
+  std::atomic<uint64_t> seq;
+  uint64_t size;
+};
+
+namespace {
+constexpr size_t Align(size_t size) {
+  return (size + 7) & ~size_t{ 7 };
+}
+}  // namespace
+
+size_t ValueRing::RequiredSize(uint32_t slots, uint32_t slot_size) {
+  return sizeof(Header) + size_t{ slots } * (sizeof(Slot) + Align(slot_size));
+}
+
+ValueRing::ValueRing(void* memory,
+    uint32_t slots,
+    uint32_t slot_size,
+    bool init)
+    : header_(static_cast<Header*>(memory)),
+      slots_(static_cast<char*>(memory) + sizeof(Header)),
+      slot_count_(slots),
+      slot_size_(slot_size) {
+  if (!init)
+    return;
+
+  std::memset(memory, 0, RequiredSize(slots, slot_size));
+  header_->slots = slots;
+  header_->slot_size = slot_size;
+  header_->write_seq.store(0, std::memory_order_release);
+}
+
+ValueRing::Slot* ValueRing::GetSlot(uint64_t seq) const {
+  auto const index = (seq - 1) % slot_count_;
+  return reinterpret_cast<Slot*>(
+      slots_ + index * (sizeof(Slot) + Align(slot_size_)));
+}
+
+bool ValueRing::Write(std::string_view data) {
+  if (header_ == nullptr || data.size() > slot_size_)
+    return false;
+
+  auto const seq = header_->write_seq.load(std::memory_order_relaxed) + 1;
+  auto* slot = GetSlot(seq);
+  slot->seq.store(2 * seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->size = data.size();
+  std::memcpy(reinterpret_cast<char*>(slot + 1), data.data(), data.size());
+  slot->seq.store(2 * seq, std::memory_order_release);
+  header_->write_seq.store(seq, std::memory_order_release);
+  return true;
+}
+
+uint64_t ValueRing::last_seq() const {
+  if (header_ == nullptr)
+    return 0;
+
+  return header_->write_seq.load(std::memory_order_acquire);
+}
+
+ValueRing::ReadResult ValueRing::Read(uint64_t seq, std::string& out) const {
+  if (seq == 0 || seq > last_seq())
+    return ReadResult::kNotWritten;
+
+  auto const* slot = GetSlot(seq);
+  if (slot->seq.load(std::memory_order_acquire) != 2 * seq)
+    return ReadResult::kOverwritten;
+
+  auto const size = slot->size;
+  if (size > slot_size_)
+    return ReadResult::kOverwritten;
+
+  out.resize(size);
+  std::memcpy(out.data(), reinterpret_cast<char const*>(slot + 1), size);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->seq.load(std::memory_order_relaxed) != 2 * seq)
+    return ReadResult::kOverwritten;
+
+  return ReadResult::kOk;
+}
+
+uint64_t ValueRing::ReadLatest(std::string& out) const {
+  // A read only fails if the writer went all the way around the ring
+  // meanwhile, which an honest writer cannot keep doing for long. The other
+  // process can also be broken or hostile, e.g. publish |write_seq| without
+  // ever completing its slot, so the retries are bounded.
+  for (uint32_t attempt = 0; attempt <= slot_count_; attempt++) {
+    auto const seq = last_seq();
+    if (seq == 0 || Read(seq, out) == ReadResult::kOk)
+      return seq;
+  }
+  return 0;
+}
+}  // namespace core
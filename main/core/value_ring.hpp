@@ -0,0 +1,81 @@
+/**
+ * Widget Sensors
+ * Shared memory value ring
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace core {
+// Single producer, single consumer ring of messages laid out in a caller
+// provided block of memory, which can be shared between processes. Each
+// slot is guarded by a sequence number: the writer never waits for the
+// reader, and a reader that races with the writer overwriting a slot sees it
+// and reads again. Neither side makes system calls.
+class ValueRing {
+public:
+  enum class ReadResult { kOk, kNotWritten, kOverwritten };
+
+  // Bytes of memory needed for |slots| messages of up to |slot_size| bytes.
+  [[nodiscard]] static size_t RequiredSize(uint32_t slots, uint32_t slot_size);
+
+  ValueRing() = default;
+  // |memory| must be 8 byte aligned and RequiredSize() bytes long. The
+  // writer, or whichever side creates the memory, formats it with |init|.
+  ValueRing(void* memory, uint32_t slots, uint32_t slot_size, bool init);
+
+  [[nodiscard]] bool valid() const {
+    return header_ != nullptr;
+  }
+
+  // Returns false if |data| is larger than a slot.
+  bool Write(std::string_view data);
+
+  // Sequence number of the newest message, 0 if none was written. Messages
+  // are numbered from 1.
+  [[nodiscard]] uint64_t last_seq() const;
+
+  // Copies message |seq| to |out|. Messages are kept until |slots| newer
+  // ones were written.
+  ReadResult Read(uint64_t seq, std::string& out) const;
+
+  // Copies the newest message to |out| and returns its sequence number, or
+  // 0 if none was written or it could not be read after |slots| + 1 tries,
+  // in which case |out| is left unspecified.
+  uint64_t ReadLatest(std::string& out) const;
+
+private:
+  struct Header;
+  struct Slot;
+
+  [[nodiscard]] Slot* GetSlot(uint64_t seq) const;
+
+  Header* header_{};
+  char* slots_{};
+  uint32_t slot_count_{};
+  uint32_t slot_size_{};
+};
+}  // namespace core
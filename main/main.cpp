@@ -29,10 +29,20 @@
 #include "shared/string_util.h"
 #include "shared/power_util.hpp"
 #include "shared/shell_util.hpp"
+#include "shared/json_writer.hpp"
 #include "resources/win/resource.h"
 #include "main/version.h"
+#include "core/change_set.hpp"
+#include "core/event_bus.hpp"
+#include "core/history.hpp"
+#include "core/poller.hpp"
+#include "core/recorder.hpp"
+#include "core/scheduler.hpp"
+#include "core/sensor_table.hpp"
+#include "core/snapshot.hpp"
+#include "plugin_host/remote_plugin.hpp"
 #include "rtss/rtss.hpp"
-#include "websocket/server.hpp"
+#include "websocket/snapshot_server.hpp"
 #include <iphlpapi.h>
 #include <icmpapi.h>
 #include <olectl.h>
@@ -43,15 +53,22 @@
 #include "steam/sdk/include/steam_api.h"
 #include "steam/sdk/include/isteamapps.h"
 #include "nlohmann/json.hpp"
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <limits>
 #include <cmath>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
 #include <string>
 #include <tuple>
 #include <thread>
 #include <shared_mutex>
 #include <fstream>
+#include <future>
 #include <sstream>
 #include <filesystem>
 #include <vector>
@@ -94,19 +111,61 @@ struct loadlibrary_deleter {
   using pointer = HMODULE;
 };
 using ScopedLoadLibrary = std::unique_ptr<HMODULE, loadlibrary_deleter>;
+// GetValues_t is only set for v1 plugins and WriteValues_t for v2 ones.
 using plugin_t = std::tuple<ScopedLoadLibrary,
     InitPlugin_t,
     GetValues_t,
     ShutdownPlugin_t,
     ExecuteCommand_t,
-    ProfileChanged_t>;
-using plugin_list_t = std::unordered_map<std::string, plugin_t>;
+    ProfileChanged_t,
+    WriteValues_t,
+    RegisterSensors_t>;
+
+// Reported as the "plugin=>NAME" sensor.
+enum class PluginState {
+  kInitializing,
+  kReady,
+  kFailed,
+  kTooLarge,
+  kSuspended
+};
+
+// A plugin of the plugins directory. The running instance is loaded from a
+// shadow copy of |source| so the DLL can be replaced, and is then reloaded.
+// Calls into |plugin| hold |mutex| shared, a reload holds it exclusively.
+// |plugin| is null if the plugin could not be restarted.
+struct PluginSlot {
+  // Timed, so that exit does not wait forever on a poll stuck in the plugin.
+  std::shared_timed_mutex mutex;
+  // Key of the plugin's state sensor, "plugin=>NAME", built once so that
+  // writing a snapshot does not allocate it.
+  std::string state_key;
+  std::unique_ptr<plugin_t> plugin;
+  std::filesystem::path shadow;
+  std::filesystem::path source;
+  std::filesystem::file_time_type write_time;
+  // Context is the owner id of the plugin's sensors, which survive reloads.
+  SensorHost sensor_host{};
+  // Held around every call into the plugin, so that a plugin never has to
+  // handle two calls at once, e.g. ProfileChanged during WriteValues.
+  std::mutex call_mutex;
+  // A profile change happened while the plugin was reloading.
+  std::atomic<bool> profile_pending{};
+  // Profile bus worker that hands profile changes to the plugin.
+  size_t profile_subscriber{};
+  std::atomic<PluginState> state{ PluginState::kInitializing };
+  // Set instead of |plugin| when the plugin runs in a host process.
+  std::unique_ptr<windows::RemotePlugin> remote;
+};
+using plugin_list_t =
+    std::unordered_map<std::string, std::unique_ptr<PluginSlot>>;
 
 constexpr wchar_t kDefaultDataDir[] = L"D:\\backgrounds";
 constexpr wchar_t kConfigFile[] = L"widget_sensors.json";
 constexpr wchar_t kInstanceMutex[] = L"widgetsensorinstance";
 constexpr wchar_t kGamesDatabase[] = L"gamedb.json";
 constexpr wchar_t kAppsDatabase[] = L"appdb.json";
+constexpr wchar_t kRecordingsDir[] = L"recordings";
 constexpr wchar_t kIgnoreList[] = L"ignore_list.json";
 constexpr wchar_t kWakeOnLan[] = L"wol.json";
 
@@ -118,22 +177,64 @@ constexpr char kPluginGetValues[] = "GetValues";
 constexpr char kPluginShutdown[] = "ShutdownPlugin";
 constexpr char kPluginExecuteCommand[] = "ExecuteCommand";
 constexpr char kPluginProfileChanged[] = "ProfileChanged";
+constexpr char kPluginGetApiVersion[] = "GetPluginApiVersion";
+constexpr char kPluginWriteValues[] = "WriteValues";
+constexpr char kPluginRegisterSensors[] = "RegisterSensors";
 
 constexpr unsigned kWebsocketPort = 30001;
 constexpr int32_t kIntervalMs = 500;
+constexpr size_t kSnapshotReserve = 20000;
+constexpr int32_t kPollBudgetMs = 100;
+// Time after which a plugin whose keys no client reads stops being polled.
+constexpr int32_t kSuspendAfterMs = 60000;
+// Samples kept per sensor by the history, an hour at the RTSS period. They
+// are compressed, a slow changing sensor takes about a byte per sample.
+constexpr size_t kHistorySamples = 14400;
+// Session recorder segment size and longest time a chunk stays in memory.
+constexpr size_t kRecorderSegmentMB = 64;
+constexpr int32_t kRecorderFlushMs = 10000;
+constexpr size_t kMaxSensorOwners = 64;
+// Quiet time after the last change in the plugins directory before changed
+// plugins are reloaded, so a DLL is not loaded while it is being copied.
+constexpr DWORD kPluginSettleMs = 1000;
+// Longest wait at exit for a plugin to return from a poll before it is left
+// loaded.
+constexpr int32_t kPluginCloseTimeoutMs = 1000;
+
+// Default sampling period of each source in milliseconds. Sources not listed
+// use kIntervalMs. Overridden by "sampling":{"rtss":100} in the config file.
+constexpr std::pair<const char*, int32_t> kSamplingPeriods[] = {
+  { "rtss", 250 },
+  { "hwinfo", 500 },
+  { "tracker", 1000 },
+  { "obs", 1000 },
+  { "twitch", 5000 },
+  { "rebar", 5000 },
+};
 
 std::unordered_multimap<std::string, std::filesystem::path> game_install_map;
 RECT current_window_size{};
 std::wstring custom_cover;
 std::shared_mutex window_mutex;
+// Filled once by LoadPlugins(), only the slots change afterwards.
 plugin_list_t plugin_list;
+std::filesystem::path shadow_dir;
+std::atomic<uint32_t> shadow_generation{};
+// Latest profile sent to the plugins, replayed to reloaded instances.
+std::mutex profile_mutex;
+std::string plugin_profile;
+// Profile changes, handled on background workers so the sampler never waits
+// for a plugin, the power scheme or the Steam lookup.
+core::EventBus<std::string> profile_bus;
+core::SensorTable sensor_table;
+// Owners whose plugin called notify_changed since the sampler last looked.
+// |change_event| wakes the sampler.
+core::ChangeSet<kMaxSensorOwners> changed_owners;
 HANDLE instance_mutex = nullptr;
 HWND hwnd;
 HANDLE quit_event{};
-CRITICAL_SECTION cs;
-std::unique_ptr<char[]> json_data;
-size_t current_size{ 2048 };
-size_t last_size{};
+HANDLE change_event{};
+core::SnapshotStore snapshot_store{ kSnapshotReserve };
 std::unordered_map<size_t, nlohmann::json> custom_commands;
 shared::IgnoreList ignore_list;
 windows::PowerUtil power_util;
@@ -552,70 +653,625 @@ std::string MapExecutableToAppId(const std::filesystem::path& data_dir,
   return "0";
 }
 
-bool LoadPlugin(const std::filesystem::path& path,
-    const std::filesystem::path& data_dir, bool debug_mode) {
+nlohmann::json ReadConfig() {
+  const auto config_file = GetConfigPath() / kConfigFile;
+  std::error_code ec;
+  if (!std::filesystem::exists(config_file, ec))
+    return {};
+
+  try {
+    std::ifstream f(config_file);
+    if (!f.good())
+      return {};
+
+    return nlohmann::json::parse(f);
+  } catch (...) {
+    return {};
+  }
+}
+
+// Reads a per-source setting in milliseconds, e.g. "sampling":{"rtss":100}.
+std::optional<std::chrono::milliseconds> GetSourceSetting(
+    nlohmann::json const& cfg,
+    const char* section,
+    std::string const& source) {
+  if (!cfg.contains(section) || !cfg[section].is_object())
+    return std::nullopt;
+
+  auto const& settings = cfg[section];
+  if (!settings.contains(source) || !settings[source].is_number_integer() ||
+      settings[source].get<int32_t>() <= 0)
+    return std::nullopt;
+
+  return std::chrono::milliseconds(settings[source].get<int32_t>());
+}
+
+std::chrono::milliseconds GetSamplingPeriod(nlohmann::json const& cfg,
+    std::string const& source) {
+  if (auto const period = GetSourceSetting(cfg, "sampling", source))
+    return *period;
+
+  for (auto const& [name, period] : kSamplingPeriods) {
+    if (source == name)
+      return std::chrono::milliseconds(period);
+  }
+
+  return std::chrono::milliseconds(kIntervalMs);
+}
+
+std::chrono::milliseconds GetPollBudget(nlohmann::json const& cfg,
+    std::string const& source) {
+  return GetSourceSetting(cfg, "pollBudget", source)
+      .value_or(std::chrono::milliseconds(kPollBudgetMs));
+}
+
+// "history":{"samples":14400} bounds the samples kept per sensor, 0 disables
+// the history.
+size_t GetHistorySamples(nlohmann::json const& cfg) {
+  if (!cfg.contains("history") || !cfg["history"].is_object())
+    return kHistorySamples;
+
+  auto const& history = cfg["history"];
+  if (!history.contains("samples") ||
+      !history["samples"].is_number_unsigned())
+    return kHistorySamples;
+
+  return history["samples"].get<size_t>();
+}
+
+// "history":{"rollups":[[1000,600],[60000,1440]]} replaces the rollup levels,
+// each given as resolution in milliseconds and number of buckets.
+std::vector<core::SensorHistory::Level> GetHistoryLevels(
+    nlohmann::json const& cfg) {
+  if (!cfg.contains("history") || !cfg["history"].is_object() ||
+      !cfg["history"].contains("rollups") ||
+      !cfg["history"]["rollups"].is_array())
+    return core::SensorHistory::DefaultLevels();
+
+  std::vector<core::SensorHistory::Level> levels;
+  for (auto const& l : cfg["history"]["rollups"]) {
+    if (l.is_array() && l.size() == 2 && l[0].is_number_unsigned() &&
+        l[1].is_number_unsigned())
+      levels.push_back({ l[0].get<int64_t>(), l[1].get<size_t>() });
+  }
+  return levels;
+}
+
+// "recorder":{"enabled":true,"segmentMB":64} records every snapshot to
+// segment files in the recordings directory.
+std::unique_ptr<core::SessionRecorder> CreateRecorder(nlohmann::json const& cfg,
+    std::filesystem::path const& data_dir) {
+  if (!cfg.contains("recorder") || !cfg["recorder"].is_object())
+    return nullptr;
+
+  auto const& recorder = cfg["recorder"];
+  if (!recorder.contains("enabled") || recorder["enabled"] != true)
+    return nullptr;
+
+  auto segment_mb = kRecorderSegmentMB;
+  if (recorder.contains("segmentMB") &&
+      recorder["segmentMB"].is_number_unsigned() &&
+      recorder["segmentMB"].get<size_t>() > 0)
+    segment_mb = recorder["segmentMB"].get<size_t>();
+
+  return std::make_unique<core::SessionRecorder>(data_dir / kRecordingsDir,
+      segment_mb << 20, std::chrono::milliseconds(kRecorderFlushMs));
+}
+
+std::chrono::milliseconds GetSuspendAfter(nlohmann::json const& cfg,
+    std::string const& source) {
+  return GetSourceSetting(cfg, "suspendAfter", source)
+      .value_or(std::chrono::milliseconds(kSuspendAfterMs));
+}
+
+// SensorHost callbacks. |context| holds the owner id of the plugin.
+static_assert(static_cast<uint32_t>(SensorType::kString) ==
+              static_cast<uint32_t>(core::SensorType::kString));
+
+uint32_t SensorOwner(void* context) {
+  return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context));
+}
+
+uint32_t PLUGIN AddSensor(void* context,
+    const char* key,
+    const char* label,
+    const char* unit,
+    SensorType type) {
+  if (key == nullptr || label == nullptr || unit == nullptr)
+    return kInvalidSensorId;
+
+  return sensor_table.Add(SensorOwner(context), key, label, unit,
+      static_cast<core::SensorType>(type));
+}
+
+void PLUGIN SetSensorNumber(void*, uint32_t id, double value) {
+  sensor_table.SetNumber(id, value);
+}
+
+void PLUGIN SetSensorBool(void*, uint32_t id, bool value) {
+  sensor_table.SetBool(id, value);
+}
+
+void PLUGIN SetSensorString(void*,
+    uint32_t id,
+    const char* value,
+    size_t size) {
+  sensor_table.SetString(id, std::string_view(value, size));
+}
+
+void PLUGIN NotifyChanged(void* context) {
+  if (changed_owners.Mark(SensorOwner(context)))
+    SetEvent(change_event);
+}
+
+// Loads a DLL and resolves its exports, without initializing it.
+std::unique_ptr<plugin_t> OpenPlugin(const std::filesystem::path& path) {
   auto lib = ScopedLoadLibrary(
       LoadLibrary(path.c_str()), loadlibrary_deleter());
   if (lib == nullptr)
-    return false;
+    return nullptr;
 
   auto init = reinterpret_cast<InitPlugin_t>(
       GetProcAddress(lib.get(), kPluginEntrypoint));
-  auto getvalues = reinterpret_cast<GetValues_t>(
-      GetProcAddress(lib.get(), kPluginGetValues));
+  auto get_api_version = reinterpret_cast<GetPluginApiVersion_t>(
+      GetProcAddress(lib.get(), kPluginGetApiVersion));
+  auto const api_version =
+      get_api_version != nullptr ? get_api_version() : uint32_t{ 1 };
+  if (api_version > kPluginApiVersion) {
+    LOG(ERROR) << "Unsupported plugin API version " << api_version;
+    return nullptr;
+  }
+
+  GetValues_t getvalues{};
+  WriteValues_t write_values{};
+  if (api_version >= 2) {
+    write_values = reinterpret_cast<WriteValues_t>(
+        GetProcAddress(lib.get(), kPluginWriteValues));
+  } else {
+    getvalues = reinterpret_cast<GetValues_t>(
+        GetProcAddress(lib.get(), kPluginGetValues));
+  }
   auto shutdown = reinterpret_cast<ShutdownPlugin_t>(
       GetProcAddress(lib.get(), kPluginShutdown));
   auto execute_command = reinterpret_cast<ExecuteCommand_t>(
       GetProcAddress(lib.get(), kPluginExecuteCommand));
   auto profile_changed = reinterpret_cast<
       ProfileChanged_t>(GetProcAddress(lib.get(), kPluginProfileChanged));
-  if (init == nullptr || getvalues == nullptr || shutdown == nullptr)
+  auto register_sensors = reinterpret_cast<RegisterSensors_t>(
+      GetProcAddress(lib.get(), kPluginRegisterSensors));
+  if (init == nullptr || shutdown == nullptr ||
+      (getvalues == nullptr && write_values == nullptr))
+    return nullptr;
+
+  LOG(INFO) << "Opened " << path.u8string() << " (API v" << api_version
+            << ")";
+  return std::make_unique<plugin_t>(std::move(lib), init, getvalues, shutdown,
+      execute_command, profile_changed, write_values, register_sensors);
+}
+
+// Copies |source| to a new file in |shadow_dir|, leaving |source| free to be
+// overwritten. Returns an empty path on failure.
+std::filesystem::path CopyToShadow(const std::filesystem::path& source) {
+  auto name = source.stem();
+  name += L"." + std::to_wstring(++shadow_generation);
+  name += kPluginExtension;
+  auto shadow = shadow_dir / name;
+
+  std::error_code ec;
+  if (!std::filesystem::copy_file(source, shadow,
+          std::filesystem::copy_options::overwrite_existing, ec)) {
+    LOG(ERROR) << "Could not copy " << source.u8string() << " to "
+               << shadow.u8string() << ". Err: " << ec.message();
+    return {};
+  }
+
+  return shadow;
+}
+
+std::unique_ptr<plugin_t> OpenShadowCopy(const std::filesystem::path& source,
+    std::filesystem::path& shadow) {
+  shadow = CopyToShadow(source);
+  if (shadow.empty())
+    return nullptr;
+
+  auto plugin = OpenPlugin(shadow);
+  if (plugin == nullptr) {
+    std::error_code ec;
+    std::filesystem::remove(shadow, ec);
+  }
+
+  return plugin;
+}
+
+// Plugins listed in "outOfProcess":["twitch","obs"] run in a host process.
+bool IsOutOfProcess(nlohmann::json const& cfg, std::string const& name) {
+  if (!cfg.contains("outOfProcess") || !cfg["outOfProcess"].is_array())
     return false;
 
-  if (!init(data_dir, debug_mode))
+  for (auto const& p : cfg["outOfProcess"]) {
+    if (p.is_string() && p.get<std::string>() == name)
+      return true;
+  }
+  return false;
+}
+
+// Unloads the plugin of |slot| and deletes its shadow copy. Must be called
+// with the slot locked exclusively.
+void ClosePlugin(std::string const& name, PluginSlot& slot) {
+  if (slot.plugin == nullptr)
+    return;
+
+  LOG(INFO) << "Shutting down plugin " << name;
+  std::get<3>(*slot.plugin)();
+  slot.plugin.reset();
+
+  std::error_code ec;
+  std::filesystem::remove(slot.shadow, ec);
+}
+
+// Initializes |plugin| and hands it the sensor host of |slot|. Must be called
+// with the slot locked exclusively.
+bool StartPlugin(std::string const& name,
+    PluginSlot& slot,
+    std::unique_ptr<plugin_t> plugin,
+    const std::filesystem::path& data_dir,
+    bool debug_mode) {
+  if (!std::get<1>(*plugin)(data_dir, debug_mode))
     return false;
 
+  if (auto const register_sensors = std::get<7>(*plugin);
+      register_sensors != nullptr && !register_sensors(&slot.sensor_host))
+    LOG(ERROR) << "Could not register sensors of " << name;
+
+  // Profile changes are replayed once the new instance is ready, and again
+  // by the next poll if one came in meanwhile.
+  slot.profile_pending = false;
+  std::string profile;
+  {
+    std::lock_guard lock(profile_mutex);
+    profile = plugin_profile;
+  }
+  if (auto const profile_changed = std::get<5>(*plugin);
+      profile_changed != nullptr && !profile.empty())
+    profile_changed(profile);
+
+  slot.plugin = std::move(plugin);
+  return true;
+}
+
+// Runs InitPlugin of a newly loaded plugin on its own thread, so a plugin that
+// takes long to start, e.g. HWiNFO waiting for its registry key, does not hold
+// up the others. The slot is locked, and so not polled, until it is done.
+void InitPluginAsync(std::string const& name,
+    PluginSlot& slot,
+    std::unique_ptr<plugin_t> plugin,
+    std::filesystem::path const& shadow,
+    std::filesystem::path const& data_dir,
+    bool debug_mode) {
+  std::unique_lock lock(slot.mutex);
+  std::error_code ec;
+  // The DLL was replaced and reloaded before this thread got the slot.
+  if (slot.state != PluginState::kInitializing) {
+    plugin.reset();
+    std::filesystem::remove(shadow, ec);
+    return;
+  }
+
+  if (StartPlugin(name, slot, std::move(plugin), data_dir, debug_mode)) {
+    LOG(INFO) << "Plugin " << name << " initialized";
+    slot.state = PluginState::kReady;
+  } else {
+    LOG(ERROR) << "Could not initialize plugin " << name;
+    std::filesystem::remove(shadow, ec);
+    slot.state = PluginState::kFailed;
+  }
+  lock.unlock();
+
+  if (changed_owners.Mark(SensorOwner(slot.sensor_host.context)))
+    SetEvent(change_event);
+}
+
+bool LoadPlugin(const std::filesystem::path& path,
+    const std::filesystem::path& data_dir,
+    bool debug_mode,
+    nlohmann::json const& cfg,
+    std::vector<std::thread>& init_threads) {
   auto file_no_ext = path.stem().u8string();
   std::transform(file_no_ext.begin(), file_no_ext.end(), file_no_ext.begin(),
       [](auto c) { return std::tolower(c); });
-  plugin_t p{ std::move(lib), init, getvalues, shutdown, execute_command,
-    profile_changed };
+
+  std::error_code ec;
+  auto slot = std::make_unique<PluginSlot>();
+  slot->state_key = "plugin=>" + file_no_ext;
+  slot->source = path;
+  slot->write_time = std::filesystem::last_write_time(path, ec);
+  auto const owner = static_cast<uintptr_t>(plugin_list.size() + 1);
+  slot->sensor_host = { reinterpret_cast<void*>(owner), &AddSensor,
+    &SetSensorNumber, &SetSensorBool, &SetSensorString, &NotifyChanged };
+
+  if (IsOutOfProcess(cfg, file_no_ext)) {
+    auto shadow = CopyToShadow(path);
+    if (shadow.empty())
+      return false;
+
+    slot->remote = std::make_unique<windows::RemotePlugin>(file_no_ext,
+        data_dir, GetSamplingPeriod(cfg, file_no_ext), change_event);
+    if (!slot->remote->Start(shadow)) {
+      std::filesystem::remove(shadow, ec);
+      return false;
+    }
+
+    LOG(INFO) << "Adding plugin " << file_no_ext << " (out of process)";
+    plugin_list.emplace(std::move(file_no_ext), std::move(slot));
+    return true;
+  }
+
+  auto plugin = OpenShadowCopy(path, slot->shadow);
+  if (plugin == nullptr)
+    return false;
+
   LOG(INFO) << "Adding plugin " << file_no_ext;
-  plugin_list.emplace(std::move(file_no_ext), std::move(p));
+  auto const it =
+      plugin_list.emplace(std::move(file_no_ext), std::move(slot)).first;
+  init_threads.emplace_back(&InitPluginAsync, std::cref(it->first),
+      std::ref(*it->second), std::move(plugin), it->second->shadow, data_dir,
+      debug_mode);
   return true;
 }
 
-auto LoadPlugins(
+// Loads the plugins of |data_dir| and starts initializing them. Returns the
+// threads running their initialization.
+std::vector<std::thread> LoadPlugins(
     const std::filesystem::path& data_dir, bool debug_mode = false) {
+  auto const cfg = ReadConfig();
+  std::vector<std::thread> init_threads;
+
+  // Shadow copies left behind by an earlier run are not in use anymore.
+  std::error_code ec;
+  shadow_dir = std::filesystem::temp_directory_path(ec) / L"widget_sensors";
+  std::filesystem::remove_all(shadow_dir, ec);
+  std::filesystem::create_directories(shadow_dir, ec);
+
   const auto plugins_dir = data_dir / kPluginsDir;
   for (auto& e : std::filesystem::directory_iterator(plugins_dir)) {
     if (!e.is_regular_file() || e.path().extension() != kPluginExtension)
       continue;
 
     LOG(INFO) << "Trying to load plugin from " << e.path().u8string();
-    if (LoadPlugin(e, data_dir, debug_mode))
+    if (LoadPlugin(e, data_dir, debug_mode, cfg, init_threads))
       LOG(INFO) << "Plugin loaded successfully";
     else
       LOG(ERROR) << "Could not load plugin from " << e.path().u8string();
   }
+
+  return init_threads;
+}
+
+// Swaps the running instance of |name| for a fresh copy of its DLL. The new
+// DLL is opened before the old instance is shut down, so a broken build
+// leaves the old one running. Polls made meanwhile keep the last values.
+void ReloadPlugin(std::string const& name,
+    PluginSlot& slot,
+    const std::filesystem::path& data_dir,
+    bool debug_mode) {
+  LOG(INFO) << "Reloading plugin " << name;
+  if (slot.remote != nullptr) {
+    if (auto shadow = CopyToShadow(slot.source); !shadow.empty())
+      slot.remote->Restart(std::move(shadow));
+
+    return;
+  }
+
+  std::filesystem::path shadow;
+  auto plugin = OpenShadowCopy(slot.source, shadow);
+  if (plugin == nullptr) {
+    LOG(ERROR) << "Could not open new version of " << name;
+    return;
+  }
+
+  std::unique_lock lock(slot.mutex);
+  ClosePlugin(name, slot);
+  slot.shadow = std::move(shadow);
+  if (StartPlugin(name, slot, std::move(plugin), data_dir, debug_mode)) {
+    LOG(INFO) << "Plugin " << name << " reloaded";
+    slot.state = PluginState::kReady;
+  } else {
+    LOG(ERROR) << "Could not start new version of " << name;
+    std::error_code ec;
+    std::filesystem::remove(slot.shadow, ec);
+    slot.state = PluginState::kFailed;
+  }
+}
+
+// Reloads plugins whose DLL changed in the plugins directory until
+// |quit_event| is set. New DLLs are not picked up.
+void WatchPlugins(const std::filesystem::path& data_dir,
+    bool debug_mode = false) {
+  const auto plugins_dir = data_dir / kPluginsDir;
+  auto change = FindFirstChangeNotificationW(plugins_dir.c_str(), false,
+      FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+  if (change == INVALID_HANDLE_VALUE) {
+    LOG(ERROR) << "Cannot watch plugins directory. Err: " << GetLastError();
+    return;
+  }
+
+  HANDLE handles[] = { quit_event, change };
+  DWORD res = WaitForMultipleObjects(_countof(handles), handles, false,
+      INFINITE);
+  while (res == WAIT_OBJECT_0 + 1) {
+    do {
+      FindNextChangeNotification(change);
+      res = WaitForMultipleObjects(_countof(handles), handles, false,
+          kPluginSettleMs);
+    } while (res == WAIT_OBJECT_0 + 1);
+    if (res != WAIT_TIMEOUT)
+      break;
+
+    for (auto& [name, slot] : plugin_list) {
+      std::error_code ec;
+      auto const write_time =
+          std::filesystem::last_write_time(slot->source, ec);
+      if (ec || write_time == slot->write_time)
+        continue;
+
+      slot->write_time = write_time;
+      ReloadPlugin(name, *slot, data_dir, debug_mode);
+    }
+
+    res = WaitForMultipleObjects(_countof(handles), handles, false,
+        INFINITE);
+  }
+
+  FindCloseChangeNotification(change);
+}
+
+// Hands |pname| to the plugin of |slot|. A plugin being reloaded gets the
+// profile once it is ready rather than holding up the worker.
+void SendProfile(PluginSlot& slot, std::string const& pname) {
+  if (slot.remote != nullptr) {
+    slot.remote->SetProfile(pname);
+    return;
+  }
+
+  std::shared_lock lock(slot.mutex, std::try_to_lock);
+  if (!lock) {
+    slot.profile_pending = true;
+    return;
+  }
+
+  if (slot.plugin == nullptr)
+    return;
+
+  auto const profile_changed = std::get<5>(*slot.plugin);
+  if (profile_changed != nullptr) {
+    std::lock_guard call_lock(slot.call_mutex);
+    profile_changed(pname);
+  }
+}
+
+// Each plugin gets its own worker, so a slow ProfileChanged, e.g. twitch
+// updating the stream info, does not delay the other plugins. A profile that
+// was replaced before its worker got to it is skipped.
+void SubscribePlugins() {
+  for (auto& [plugin_name, slot] : plugin_list) {
+    slot->profile_subscriber = profile_bus.Subscribe(
+        [&slot = *slot](std::string const& pname,
+            core::CancelToken const& token) {
+          if (!token.cancelled())
+            SendProfile(slot, pname);
+        });
+  }
 }
 
 void OnProfileChanged(std::string const& pname) {
-  for (auto& [plugin_name, p] : plugin_list) {
-    auto const profile_changed = std::get<5>(p);
-    if (profile_changed != nullptr) {
-      profile_changed(pname);
+  {
+    std::lock_guard lock(profile_mutex);
+    plugin_profile = pname;
+  }
+
+  profile_bus.Post(pname);
+}
+
+PluginState GetPluginState(PluginSlot const& slot) {
+  if (slot.remote == nullptr)
+    return slot.state;
+
+  switch (slot.remote->state()) {
+    case windows::HostState::kRunning:
+      return PluginState::kReady;
+    case windows::HostState::kFailed:
+      return PluginState::kFailed;
+    case windows::HostState::kTooLarge:
+      return PluginState::kTooLarge;
+    default:
+      return PluginState::kInitializing;
+  }
+}
+
+const char* ToString(PluginState state) {
+  switch (state) {
+    case PluginState::kReady:
+      return "ready";
+    case PluginState::kFailed:
+      return "failed";
+    case PluginState::kTooLarge:
+      return "tooLarge";
+    case PluginState::kSuspended:
+      return "suspended";
+    default:
+      return "initializing";
+  }
+}
+
+// PluginWriter::append for v2 plugins, |context| is the std::string being
+// written.
+void PLUGIN AppendPluginOutput(void* context, const char* data, size_t size) {
+  static_cast<std::string*>(context)->append(data, size);
+}
+
+// Writes the values of the plugin of |slot| to |out|. Returns false while the
+// plugin is being reloaded or handles another call, in which case its last
+// values are kept.
+bool PollPlugin(PluginSlot& slot,
+    std::wstring const& profile,
+    std::string& out) {
+  // Out of process plugins include their typed sensors already.
+  if (slot.remote != nullptr)
+    return slot.remote->Read(out);
+
+  std::shared_lock lock(slot.mutex, std::try_to_lock);
+  if (!lock || slot.plugin == nullptr)
+    return false;
+
+  // A profile change missed while reloading goes to the plugin's bus worker,
+  // so that neither the poll budget nor the profile lock wait for it.
+  if (slot.profile_pending.exchange(false)) {
+    std::string pname;
+    {
+      std::lock_guard profile_lock(profile_mutex);
+      pname = plugin_profile;
     }
+    profile_bus.Post(slot.profile_subscriber, pname);
+  }
+
+  // The plugin is still handling a profile change or a command.
+  std::unique_lock call_lock(slot.call_mutex, std::try_to_lock);
+  if (!call_lock)
+    return false;
+
+  auto const& p = *slot.plugin;
+
+  bool ok;
+  if (auto const write_values = std::get<6>(p); write_values != nullptr) {
+    PluginWriter writer{ &out, &AppendPluginOutput };
+    ok = write_values(profile.c_str(), &writer);
+  } else {
+    // v1 plugins return UTF-16 text that has to be converted.
+    util::AppendUtf8(out, std::get<2>(p)(profile), false);
+    ok = true;
   }
+
+  // Typed sensors are serialized by the host after the plugin's own output.
+  sensor_table.Write(SensorOwner(slot.sensor_host.context), out);
+  return ok;
 }
 
 BOOL WINAPI Shutdown(DWORD) {
-  for (auto& [plugin_name, p] : plugin_list) {
-    auto const shutdown = std::get<3>(p);
-    if (shutdown != nullptr) {
-      LOG(INFO) << "Shutting down plugin " << plugin_name;
-      shutdown();
+  for (auto& [plugin_name, slot] : plugin_list) {
+    if (slot->remote != nullptr)
+      slot->remote->Stop();
+
+    // A poll stuck in the plugin keeps the slot locked, on a worker the
+    // poller detached. Unloading the DLL would pull the code from under it,
+    // so the slot and its module are leaked instead.
+    std::unique_lock lock(slot->mutex, std::defer_lock);
+    if (!lock.try_lock_for(std::chrono::milliseconds(kPluginCloseTimeoutMs))) {
+      LOG(WARN) << "Plugin " << plugin_name << " is busy, leaving it loaded";
+      static_cast<void>(slot.release());
+      continue;
     }
+
+    ClosePlugin(plugin_name, *slot);
   }
 
   CloseHandle(instance_mutex);
@@ -711,36 +1367,91 @@ auto SendWoL(const std::filesystem::path& config) {
     constexpr char kBroadcastAddress[]{ "broadcast_address" };
     std::ifstream file(config);
     const auto json = nlohmann::json::parse(file);
+    std::vector<std::pair<std::string, std::string>> devices;
     for (auto&& [a, i] : json.items()) {
       if (!i.contains(kMacAddress) || !i.contains(kBroadcastAddress)) {
         LOG(ERROR) << "Missing required fields (mac_address/broadcast_address)";
         return;
       }
 
-      const std::string mac_address = i[kMacAddress];
-      const std::string ip = GetDeviceIpFromMacAddress(mac_address);
-      if (!ip.empty() && PingIPAddress(ip)) {
-        LOG(INFO) << "Skipping " << mac_address << " - already online";
-        continue;
-      }
+      devices.emplace_back(i[kMacAddress].get<std::string>(),
+          i[kBroadcastAddress].get<std::string>());
+    }
 
-      const std::string broadcast_address = i[kBroadcastAddress];
-      LOG(INFO) << "Sending magic packet to " << mac_address;
-      for (int i = 0; i < 5; i++) {
-        try {
-          SendMagicPacket(mac_address, broadcast_address);
-          break;
-        } catch (std::exception& e) {
-          LOG(ERROR) << "Error processing magic packet. " << e.what();
-          Sleep(500);
+    // Devices are pinged in parallel, each ping can take up to a second.
+    std::vector<std::future<void>> wakes;
+    for (auto const& device : devices) {
+      wakes.push_back(std::async(std::launch::async, [&device] {
+        auto const& [mac_address, broadcast_address] = device;
+        const std::string ip = GetDeviceIpFromMacAddress(mac_address);
+        if (!ip.empty() && PingIPAddress(ip)) {
+          LOG(INFO) << "Skipping " << mac_address << " - already online";
+          return;
         }
-      }
+
+        LOG(INFO) << "Sending magic packet to " << mac_address;
+        for (int i = 0; i < 5; i++) {
+          try {
+            SendMagicPacket(mac_address, broadcast_address);
+            break;
+          } catch (std::exception& e) {
+            LOG(ERROR) << "Error processing magic packet. " << e.what();
+            Sleep(500);
+          }
+        }
+      }));
     }
+
+    for (auto& w : wakes)
+      w.wait();
   } catch (...) {
     LOG(ERROR) << "Error processing config file";
   }
 }
 
+// Writes "source":{...} with the last tick jitter.
+void WriteSchedulerStats(util::JsonWriter& writer,
+    core::Scheduler::Stats const& stats) {
+  using ms_t = std::chrono::duration<double, std::milli>;
+  writer.Key(stats.name);
+  writer.BeginObject();
+  writer.Key("jitter");
+  writer.Number(ms_t(stats.jitter).count(), 3);
+  writer.Key("maxJitter");
+  writer.Number(ms_t(stats.max_jitter).count(), 3);
+  writer.Key("overruns");
+  writer.Number(stats.overruns);
+  writer.Key("ticks");
+  writer.Number(stats.ticks);
+  writer.EndObject();
+}
+
+// Writes "plugin":{...} with the poll latency quantiles.
+void WritePollerStats(util::JsonWriter& writer,
+    core::Poller::Stats const& stats) {
+  using ms_t = std::chrono::duration<double, std::milli>;
+  writer.Key(stats.name);
+  writer.BeginObject();
+  writer.Key("p50");
+  writer.Number(ms_t(stats.latency.Quantile(0.5)).count(), 3);
+  writer.Key("p99");
+  writer.Number(ms_t(stats.latency.Quantile(0.99)).count(), 3);
+  writer.Key("max");
+  writer.Number(ms_t(stats.latency.max()).count(), 3);
+  writer.Key("stale");
+  writer.Bool(stats.stale);
+  writer.Key("timeouts");
+  writer.Number(stats.timeouts);
+  writer.Key("failures");
+  writer.Number(stats.failures);
+  writer.Key("histogram");
+  writer.BeginArray();
+  for (auto const count : stats.latency.buckets())
+    writer.Number(count);
+  writer.EndArray();
+  writer.EndObject();
+}
+
 auto StartMonitoring(const wchar_t* data_dir) {
   std::error_code ec;
   if (data_dir == nullptr || !std::filesystem::exists(data_dir, ec) ||
@@ -748,11 +1459,57 @@ auto StartMonitoring(const wchar_t* data_dir) {
     data_dir = kDefaultDataDir;
 
   const auto path = std::filesystem::path(data_dir);
-  LoadPlugins(path);
+  // Plugins and Wake-on-LAN run in the background, the websocket server
+  // starts right away.
+  auto plugin_init = LoadPlugins(path);
+  std::thread plugin_watcher(&WatchPlugins, path, false);
+  std::thread wol(&SendWoL, path / kWakeOnLan);
+
+  // Steam app of the current profile, looked up on a profile bus worker. A
+  // lookup that finishes after the profile changed again is dropped.
+  struct {
+    std::mutex mutex;
+    uint32 id{};
+    std::string poster;
+  } steam_app;
+
+  SubscribePlugins();
+  profile_bus.Subscribe(
+      [](std::string const& pname, core::CancelToken const& token) {
+        if (!pname.empty() && !token.cancelled())
+          static_cast<void>(power_util.SetScheme(
+              windows::PowerScheme::kPowerUltimatePerformance));
+      });
+  profile_bus.Subscribe([&](std::string const& pname,
+                            core::CancelToken const& token) {
+    if (pname.empty() || token.cancelled())
+      return;
+
+    auto const app_image = MapExecutableToAppId(path, string2wstring(pname));
+    uint32 app_id{};
+    try {
+      app_id = static_cast<uint32>(std::stoi(app_image));
+      if (app_id) {
+        LOG(INFO) << "Found app id " << app_id;
+      } else {
+        LOG(INFO) << "app id=0 app_image=" << app_image;
+      }
+    } catch (...) {
+    }
 
-  SendWoL(path / kWakeOnLan);
+    std::lock_guard lock(steam_app.mutex);
+    if (token.cancelled())
+      return;
 
-  std::unique_ptr<network::WebsocketServer> server;
+    steam_app.id = app_id;
+    steam_app.poster = app_image.find("http") == 0 ? app_image : "";
+  });
+
+  // Declared first, the server serves the history until it shuts down.
+  auto const history_cfg = ReadConfig();
+  core::SensorHistory history(
+      GetHistorySamples(history_cfg), GetHistoryLevels(history_cfg));
+  std::unique_ptr<network::SnapshotServer> server;
   int result = 0;
 
   message_handler.emplace(
@@ -776,39 +1533,58 @@ auto StartMonitoring(const wchar_t* data_dir) {
     uint32 current_app{};
     std::string app_poster;
     rtss::RTSSSharedMemory rtss;
-    size_t data_size{};
-    auto send_buffer = std::make_unique<char[]>(current_size);
 
     const auto set_current_profile = [&](std::wstring pname) {
       OnProfileChanged(wstring2string(pname));
       current_profile = std::move(pname);
+
+      std::lock_guard lock(steam_app.mutex);
+      steam_app.id = 0;
+      steam_app.poster.clear();
     };
 
-    const auto get_cover = [&](const std::string& msg) -> std::string {
+    const auto get_cover = [&](nlohmann::json const& msg) -> std::string {
       try {
-        const auto json = nlohmann::json::parse(msg);
-        if (!json.contains("msg") || !json["msg"].is_object())
-          return "";
-
-        return HandleWebsocketMessage(json["msg"]);
+        if (!msg.is_null())
+          return HandleWebsocketMessage(msg);
       } catch (...) {
       }
       return "";
     };
 
-    server = std::make_unique<network::WebsocketServer>(kWebsocketPort);
-    if (!server->Start([&](auto&& hdl, auto&& msg) {
-          std::string cover = get_cover(msg);
-          if (cover.empty()) {
-            EnterCriticalSection(&cs);
-            memcpy(send_buffer.get(), json_data.get(), data_size);
-            LeaveCriticalSection(&cs);
-
-            server->Send(hdl, send_buffer.get(), data_size);
-          } else {
-            custom_cover = string2wstring(cover);
-          }
-        })) {
+    auto recorder = CreateRecorder(history_cfg, path);
+    if (recorder != nullptr)
+      recorder->Start();
+
+    server = std::make_unique<network::SnapshotServer>(
+        kWebsocketPort, snapshot_store, history);
+
+    // "websocket":{"compressionThreshold":256} in the config file. Messages
+    // below the threshold are not compressed, -1 disables compression.
+    if (auto const cfg = ReadConfig(); cfg.contains("websocket") &&
+                                       cfg["websocket"].is_object()) {
+      auto const& ws = cfg["websocket"];
+      if (ws.contains("compressionThreshold") &&
+          ws["compressionThreshold"].is_number_integer()) {
+        auto const threshold = ws["compressionThreshold"].get<int64_t>();
+        server->SetCompressionThreshold(threshold < 0
+                                            ? std::numeric_limits<size_t>::max()
+                                            : static_cast<size_t>(threshold));
+      }
+    }
+    // A client connecting, leaving or changing its selection wakes the
+    // sampler up, so that a plugin suspended for lack of readers resumes at
+    // once.
+    if (!server->Start(
+            [&](nlohmann::json const& request) {
+              std::string cover = get_cover(request);
+              if (cover.empty())
+                return false;
+
+              custom_cover = string2wstring(cover);
+              return true;
+            },
+            [] { SetEvent(change_event); })) {
       std::cerr << "Could not start websocket server on port " << kWebsocketPort
                 << std::endl;
       result = 2;
@@ -818,138 +1594,356 @@ auto StartMonitoring(const wchar_t* data_dir) {
     std::wcout << L"Websocket server listening to port " << kWebsocketPort
                << std::endl;
 
-    DWORD wait_result;
-    const auto write_sensors_file = [&](auto&& data) {
-      EnterCriticalSection(&cs);
-      const auto s = wstring2string(data);
-      data_size = s.size();
-      if (data_size > current_size) {
-        auto new_size = data_size * 2;
-        LOG(INFO) << "Resizing buffer from " << current_size << " to "
-                  << new_size;
-        current_size = new_size;
-        json_data.reset(new char[current_size]);
-        send_buffer.reset(new char[current_size]);
-      }
-
-      memcpy(json_data.get(), s.c_str(), data_size);
-      last_size = data_size;
-      LeaveCriticalSection(&cs);
+    auto const cfg = ReadConfig();
+    core::Scheduler scheduler;
+    auto const rtss_source =
+        scheduler.Add("rtss", GetSamplingPeriod(cfg, "rtss"));
+    auto const stats_source =
+        scheduler.Add("scheduler", std::chrono::seconds(1));
+
+    // Plugins are polled concurrently, each within its own budget, so a slow
+    // plugin only holds back its own values. Polls mostly wait on I/O or on
+    // other processes, so each plugin gets a worker whatever the core count,
+    // and one stuck in a plugin does not hold back the others.
+    core::Poller poller(plugin_list.size());
+    struct PluginSource {
+      std::string const* name;
+      size_t source;
+      size_t poll_id;
+      uint32_t owner;
+      PluginSlot const* slot;
+      windows::RemotePlugin* remote;
+      std::string last;  // Fragment used by the last snapshot
+      PluginState state;  // State used by the last snapshot
+      std::chrono::milliseconds suspend_after;
+      core::Scheduler::clock_t::time_point last_demand;
+      bool suspended{};
+      bool stale{};  // |last| is from an earlier poll
+      // Entries of |last|, so that the snapshot is indexed without parsing
+      // the fragments again while they do not change.
+      std::vector<core::SensorEntry> index;
     };
+    std::vector<PluginSource> plugin_sources;
+    for (auto& [plugin_name, slot] : plugin_list) {
+      auto const source =
+          scheduler.Add(plugin_name, GetSamplingPeriod(cfg, plugin_name));
+      auto const poll_id = poller.Add(
+          plugin_name,
+          [&slot = *slot](std::wstring const& profile, std::string& out) {
+            return PollPlugin(slot, profile, out);
+          },
+          GetPollBudget(cfg, plugin_name));
+      plugin_sources.push_back({ &plugin_name, source, poll_id,
+          SensorOwner(slot->sensor_host.context), slot.get(),
+          slot->remote.get(), {}, GetPluginState(*slot),
+          GetSuspendAfter(cfg, plugin_name),
+          core::Scheduler::clock_t::now() });
+    }
+    std::vector<size_t> polled;
+    std::vector<size_t> changed;
 
-    std::wstring str_buffer;
-    str_buffer.reserve(20000);
+    DWORD wait_result;
+    util::JsonWriter writer;
+    std::string process_path;
+    std::string last_process_path;
+    uint32_t ignore_list_version{};
+    std::wstring pname;
+    double framerate{}, framerate_raw{}, frametime{}, frametime_raw{};
+    LONG width{}, height{};
+    std::string sampler_stats;
+    uint64_t recorder_dropped{};
+    std::vector<size_t> due;
     do {
-      std::wostringstream o(str_buffer);
-      o << LR"({"sensors":{)";
-
-      auto [framerate, framerate_raw] = rtss.GetFramerate();
-      auto [frametime, frametime_raw] = rtss.GetFrametime();
-      auto pname = string2wstring(rtss.GetCurrentProcessName());
-      auto process_name = [&] {
-        if (auto const p = pname.rfind(L'\\'); p != std::string::npos)
-          return &pname.c_str()[p + 1];
-
-        return pname.c_str();
-      }();
-
-      if (ignore_list.IsIgnoredProcess(pname)) {
-        process_name = L"";
-        pname.clear();
-      }
+      auto const now = core::Scheduler::clock_t::now();
+      scheduler.Collect(now, due);
+      auto const is_due = [&](size_t source) {
+        return std::find(due.begin(), due.end(), source) != due.end();
+      };
+      changed.clear();
+      changed_owners.Take(changed);
+      auto const is_changed = [&](uint32_t owner) {
+        return owner != 0 &&
+               std::find(changed.begin(), changed.end(), owner) !=
+                   changed.end();
+      };
+
+      if (is_due(rtss_source)) {
+        std::tie(framerate, framerate_raw) = rtss.GetFramerate();
+        std::tie(frametime, frametime_raw) = rtss.GetFrametime();
+        rtss.GetCurrentProcessName(process_path);
+        if (process_path != last_process_path ||
+            ignore_list.GetVersion() != ignore_list_version) {
+          last_process_path = process_path;
+          ignore_list_version = ignore_list.GetVersion();
+          pname = string2wstring(process_path);
+          if (ignore_list.IsIgnoredProcess(pname))
+            pname.clear();
+        }
 
-      uint32 app_id{};
-      if (!pname.empty()) {
-        if (current_profile.empty() || pname != current_profile) {
-          LOG(INFO) << "Got new profile " << wstring2string(pname);
-          static_cast<void>(power_util.SetScheme(
-              windows::PowerScheme::kPowerUltimatePerformance));
-          set_current_profile(pname);
-          auto const app_image = MapExecutableToAppId(path, pname);
-          app_poster = app_image.find("http") == 0 ? app_image : "";
-          try {
-            app_id = static_cast<uint32>(std::stoi(app_image));
-            if (app_id) {
-              LOG(INFO) << "Found app id " << app_id;
-            } else {
-              LOG(INFO) << "app id=0 app_image=" << app_image;
-            }
-          } catch (...) {
+        if (!pname.empty()) {
+          if (current_profile.empty() || pname != current_profile) {
+            LOG(INFO) << "Got new profile " << wstring2string(pname);
+            set_current_profile(pname);
           }
-          current_app = app_id;
+        } else if (!current_profile.empty()) {
+          LOG(INFO) << "Reseting profile";
+          set_current_profile({});
+
+          std::unique_lock lock(window_mutex);
+          current_window_size = {};
+
+          //SetPowerScheme(PowerScheme::kPowerBalanced);
         }
-      } else if (!current_profile.empty()) {
-        LOG(INFO) << "Reseting profile";
-        set_current_profile({});
-        current_app = 0;
-        app_poster.clear();
 
-        std::unique_lock lock(window_mutex);
-        current_window_size = {};
+        {
+          std::shared_lock lock(window_mutex);
+          width = current_window_size.right;
+          height = current_window_size.bottom;
+        }
 
-        //SetPowerScheme(PowerScheme::kPowerBalanced);
+        {
+          std::lock_guard lock(steam_app.mutex);
+          current_app = steam_app.id;
+          app_poster = steam_app.poster;
+        }
       }
 
-      LONG width, height;
-      {
-        std::shared_lock lock(window_mutex);
-        width = current_window_size.right;
-        height = current_window_size.bottom;
+      // Plugins that notified a change, or whose host published new values,
+      // are polled right away, the others when their period is up. Plugins
+      // with typed sensors that no client read for a while are suspended
+      // until one of their keys is requested again. The recorder reads every
+      // key, so nothing is suspended while it runs.
+      auto const demand = server->demand();
+      polled.clear();
+      for (auto& ps : plugin_sources) {
+        bool resumed = false;
+        if (recorder != nullptr ||
+            sensor_table.IsDemanded(ps.owner, *demand).value_or(true)) {
+          resumed = ps.suspended;
+          ps.suspended = false;
+          ps.last_demand = now;
+        } else if (!ps.suspended && now - ps.last_demand >= ps.suspend_after) {
+          LOG(INFO) << "Suspending " << *ps.name << ", no client reads it";
+          ps.suspended = true;
+        }
+
+        if (ps.suspended)
+          continue;
+
+        if (resumed)
+          LOG(INFO) << "Resuming " << *ps.name;
+
+        if (resumed || is_due(ps.source) || is_changed(ps.owner) ||
+            (ps.remote != nullptr && ps.remote->HasNewValues()))
+          polled.push_back(ps.poll_id);
       }
+      poller.Poll(polled, current_profile);
+
+      bool modified = is_due(rtss_source);
+      for (auto& ps : plugin_sources) {
+        // The values of a suspended plugin are left out rather than served
+        // frozen, so that neither clients nor the history take them as
+        // current.
+        if (ps.suspended) {
+          if (!ps.last.empty()) {
+            ps.last.clear();
+            ps.index.clear();
+            modified = true;
+          }
+        } else {
+          auto const result = poller.Get(ps.poll_id);
+          if (*result.fragment != ps.last) {
+            ps.last = *result.fragment;
+            static_cast<void>(core::IndexMembers(ps.last, ps.index));
+            modified = true;
+          }
+          if (result.stale != ps.stale) {
+            ps.stale = result.stale;
+            modified = true;
+          }
+        }
 
-      o << L"\"rtss=>framerate\": {\"sensor\":\"framerate\",\"value\":"
-        << framerate << L",\"valueRaw\":" << framerate_raw << L"},";
-      o << L"\"rtss=>frametime\": {\"sensor\":\"frametime\",\"value\":"
-        << frametime << L",\"valueRaw\":" << frametime_raw << L"},";
-      o << L"\"rtss=>process\": {\"sensor\":\"process\",\"value\":\""
-        << process_name << L"\"},";
-      o << L"\"steam=>app\": {\"sensor\":\"app\",\"value\":" << current_app
-        << L"},";
-      o << L"\"game=>poster\": {\"sensor\":\"poster\",\"value\":\""
-        << string2wstring(app_poster) << L"\"},";
-      if (width && height) {
-        o << L"\"game=>size\": {\"sensor\":\"size\",\"value\":\"" << width
-          << L"x" << height << L"\"}";
-      } else {
-        o << L"\"game=>size\": {\"sensor\":\"size\",\"value\":\"\"}";
+        auto const state =
+            ps.suspended ? PluginState::kSuspended : GetPluginState(*ps.slot);
+        if (state != ps.state) {
+          ps.state = state;
+          modified = true;
+        }
       }
-      o << L",\"custom_cover\": {\"sensor\":\"size\",\"value\":\""
-        << custom_cover << L"\"}";
-
-      for (auto& [plugin_name, p] : plugin_list) {
-        auto const getvalues = std::get<2>(p);
-        if (getvalues != nullptr) {
-          const auto v = getvalues(current_profile);
-          if (!v.empty())
-            o << L"," << v;
+
+      // Served by the "stats" action rather than as sensors, so that they
+      // neither force a new snapshot nor end up in the history.
+      if (is_due(stats_source)) {
+        writer.Reset(sampler_stats);
+        writer.Key("scheduler");
+        writer.BeginObject();
+        for (auto const& st : scheduler.stats())
+          WriteSchedulerStats(writer, st);
+        writer.EndObject();
+
+        writer.Key("poller");
+        writer.BeginObject();
+        for (auto const& st : poller.GetStats())
+          WritePollerStats(writer, st);
+        writer.EndObject();
+
+        if (recorder != nullptr) {
+          auto const dropped = recorder->dropped();
+          if (dropped != recorder_dropped) {
+            LOG(WARN) << "Recorder dropped " << dropped - recorder_dropped
+                      << " snapshots, the disk is not keeping up";
+            recorder_dropped = dropped;
+          }
+          writer.Key("recorder");
+          writer.BeginObject();
+          writer.Key("dropped");
+          writer.Number(dropped);
+          writer.EndObject();
         }
+        server->SetStats(sampler_stats);
       }
-      o << L"}}";
 
-      write_sensors_file(o.str());
+      // The snapshot is only rebuilt when a source brought new data.
+      if (modified) {
+        auto process_name = [&] {
+          if (auto const p = pname.rfind(L'\\'); p != std::string::npos)
+            return &pname.c_str()[p + 1];
+
+          return pname.c_str();
+        }();
+
+        // The snapshot is indexed as it is written, rather than parsed again
+        // when it is published.
+        auto snapshot = snapshot_store.Acquire();
+        auto const& data = snapshot->data;
+        writer.Reset(snapshot->data);
+        snapshot->BeginIndex();
+        writer.BeginObject();
+        writer.Key("sensors");
+        writer.BeginObject();
+        auto const builtin = data.size();
+
+        writer.Key("rtss=>framerate");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("framerate");
+        writer.Key("value");
+        writer.Number(framerate);
+        writer.Key("valueRaw");
+        writer.Number(framerate_raw);
+        writer.EndObject();
+
+        writer.Key("rtss=>frametime");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("frametime");
+        writer.Key("value");
+        writer.Number(frametime);
+        writer.Key("valueRaw");
+        writer.Number(frametime_raw);
+        writer.EndObject();
+
+        writer.Key("rtss=>process");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("process");
+        writer.Key("value");
+        writer.String(process_name);
+        writer.EndObject();
+
+        writer.Key("steam=>app");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("app");
+        writer.Key("value");
+        writer.Number(current_app);
+        writer.EndObject();
+
+        writer.Key("game=>poster");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("poster");
+        writer.Key("value");
+        writer.String(app_poster);
+        writer.EndObject();
+
+        writer.Key("game=>size");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("size");
+        writer.Key("value");
+        if (width && height) {
+          std::array<char, 32> size;
+          auto res =
+              std::to_chars(size.data(), size.data() + size.size(), width);
+          *res.ptr++ = 'x';
+          res = std::to_chars(res.ptr, size.data() + size.size(), height);
+          writer.String(std::string_view(size.data(), res.ptr - size.data()));
+        } else {
+          writer.String("");
+        }
+        writer.EndObject();
+
+        writer.Key("custom_cover");
+        writer.BeginObject();
+        writer.Key("sensor");
+        writer.String("size");
+        writer.Key("value");
+        writer.String(custom_cover);
+        writer.EndObject();
+        snapshot->IndexMembers(builtin);
+
+        for (auto const& ps : plugin_sources) {
+          auto const state = data.size();
+          writer.Key(ps.slot->state_key);
+          writer.BeginObject();
+          writer.Key("sensor");
+          writer.String("state");
+          writer.Key("value");
+          writer.String(ToString(ps.state));
+          writer.Key("stale");
+          writer.Bool(ps.stale && !ps.suspended);
+          writer.EndObject();
+          snapshot->IndexMembers(state);
+
+          writer.RawMembers(ps.last);
+          snapshot->AddMembers(data.size() - ps.last.size(), ps.last, ps.index);
+        }
 
-      auto before_check = std::chrono::system_clock::now();
-      wait_result = WaitForSingleObject(quit_event, kIntervalMs >> 2);
-      if (wait_result == WAIT_TIMEOUT) {
-        continue;
-      } else if (wait_result == WAIT_OBJECT_0) {
-        break;
+        writer.EndObject();
+        writer.EndObject();
+        static_cast<void>(snapshot->EndIndex());
+
+        // Sources polled on their own period often have nothing new, in which
+        // case there is nothing to publish either.
+        auto const time =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        if (server->Publish(std::move(snapshot), time) && recorder != nullptr)
+          recorder->Add(snapshot_store.Current(), time);
       }
 
-      auto after_check = std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::system_clock::now() - before_check);
-      if (after_check.count() < kIntervalMs) {
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(kIntervalMs) - after_check);
-      }
+      // Sleeps until the next deadline or until a plugin notifies a change.
+      auto const wait = std::chrono::ceil<std::chrono::milliseconds>(
+          scheduler.NextDeadline() - core::Scheduler::clock_t::now());
+      HANDLE const handles[] = { quit_event, change_event };
+      wait_result = WaitForMultipleObjects(_countof(handles), handles, false,
+          static_cast<DWORD>(std::max<int64_t>(wait.count(), 0)));
     } while (wait_result != WAIT_OBJECT_0);
   } while (false);
 
   if (server)
     server->Shutdown();
 
-  DeleteCriticalSection(&cs);
+  profile_bus.Stop();
 
+  // The watcher also stops here when the server could not be started.
+  SetEvent(quit_event);
+  plugin_watcher.join();
+  for (auto& t : plugin_init)
+    t.join();
+  wol.join();
   Shutdown(0);
 
   LOG(INFO) << "Exiting...";
@@ -972,8 +1966,11 @@ void CopyCurrentData() {
 
   EmptyClipboard();
   do {
+    auto const snapshot = snapshot_store.Current();
+    auto const size = snapshot ? snapshot->data.size() : 0;
+
     // Allocate a global memory object for the text.
-    auto hglbCopy = GlobalAlloc(GMEM_MOVEABLE, last_size + 1);
+    auto hglbCopy = GlobalAlloc(GMEM_MOVEABLE, size + 1);
     if (hglbCopy == NULL) {
       LOG(ERROR) << "GlobalAlloc fail";
       break;
@@ -982,10 +1979,9 @@ void CopyCurrentData() {
     // Lock the handle and copy the text to the buffer.
     auto copy = reinterpret_cast<char*>(GlobalLock(hglbCopy));
     if (copy != nullptr) {
-      EnterCriticalSection(&cs);
-      memcpy(copy, json_data.get(), last_size);
-      LeaveCriticalSection(&cs);
-      copy[last_size] = '\0';
+      if (size > 0)
+        memcpy(copy, snapshot->data.data(), size);
+      copy[size] = '\0';
       GlobalUnlock(hglbCopy);
     }
 
@@ -1022,10 +2018,6 @@ void ExecuteCustomCommand(size_t index) {
     if (it == plugin_list.end())
       return;
 
-    auto execute_command = std::get<4>(it->second);
-    if (execute_command == nullptr)
-      return;
-
     std::string command = custom_command["command"];
     auto params = custom_command.contains("params") &&
                           custom_command["params"].is_object()
@@ -1033,6 +2025,26 @@ void ExecuteCustomCommand(size_t index) {
                       : std::vector<std::string>();
 
     nlohmann::json const cmd { { "command", command }, { "params", params } };
+    auto& slot = *it->second;
+    if (slot.remote != nullptr) {
+      // Runs asynchronously in the host, failures are only logged there.
+      if (!slot.remote->ExecuteCommand(cmd.dump()))
+        LOG(ERROR) << "Command too long for plugin host " << command;
+      return;
+    }
+
+    // Commands are not queued for a plugin that is still starting.
+    std::shared_lock lock(slot.mutex, std::try_to_lock);
+    if (!lock || slot.plugin == nullptr) {
+      LOG(ERROR) << "Plugin " << action << " is not ready for " << command;
+      return;
+    }
+
+    auto execute_command = std::get<4>(*slot.plugin);
+    if (execute_command == nullptr)
+      return;
+
+    std::lock_guard call_lock(slot.call_mutex);
     if (!execute_command(cmd.dump()))
       LOG(ERROR) << "Error executing command " << command;
   } catch (...) {
@@ -1061,22 +2073,7 @@ void AddMenu(HMENU hmenu, int& pos, nlohmann::json const& popup) {
 }
 
 void GetMenuOptions(HMENU hmenu, int& pos) {
-  const auto config_file = GetConfigPath() / kConfigFile;
-  std::error_code ec;
-  if (!std::filesystem::exists(config_file, ec))
-    return;
-
-  auto cfg = [&]() -> nlohmann::json {
-    try {
-      std::ifstream f(config_file);
-      if (!f.good())
-        return {};
-
-      return nlohmann::json::parse(f);
-    } catch (...) {
-      return {};
-    }
-  }();
+  auto cfg = ReadConfig();
   if (cfg.empty())
     return;
 
@@ -1314,33 +2311,7 @@ void SetProcessAffinity() {
   }
 }
 
-}  // namespace
-
-int WINAPI wWinMain(HINSTANCE hInstance,
-    HINSTANCE hPrevInstance,
-    PWSTR pCmdLine,
-    int nCmdShow) {
-  if (IsRunning(&instance_mutex)) {
-    LOG(ERROR) << "Another instance is already running";
-    return 1;
-  }
-
-  int argc;
-  auto const argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-
-  SetProcessAffinity();
-
-  if (!CreateWindowResources(hInstance))
-    return 1;
-
-  SetMainCommandHandlers();
-
-  quit_event = CreateEvent(nullptr, true, false, nullptr);
-  if (quit_event == nullptr) {
-    LOG(ERROR) << "Cannot create event. Err: " << GetLastError();
-    return 1;
-  }
-
+bool InitializeCom() {
   // Step 1: --------------------------------------------------
   // Initialize COM. ------------------------------------------
 
@@ -1348,7 +2319,7 @@ int WINAPI wWinMain(HINSTANCE hInstance,
   if (FAILED(hres)) {
     LOG(ERROR) << "Failed to initialize COM library. Error code = 0x"
                << std::hex << hres;
-    return 1;
+    return false;
   }
 
   // Step 2: --------------------------------------------------
@@ -1368,12 +2339,144 @@ int WINAPI wWinMain(HINSTANCE hInstance,
     LOG(ERROR) << "Failed to initialize security. Error code = 0x" << std::hex
                << hres;
     CoUninitialize();
+    return false;
+  }
+  return true;
+}
+
+// Entry point of a plugin host process, started by RemotePlugin with
+// --plugin-host <shared memory> <dll> <data dir> <period ms>. The plugin is
+// polled on its period, or as soon as it notifies a change, and its values
+// are published to the server through shared memory.
+int RunPluginHost(int argc, wchar_t** argv) {
+  if (argc < 6)
+    return 1;
+
+  windows::HostChannel channel;
+  if (!channel.Open(argv[2]))
+    return 1;
+
+  auto& control = channel.control();
+  auto const notify = reinterpret_cast<HANDLE>(control.notify_event);
+  auto const wake = reinterpret_cast<HANDLE>(control.wake_event);
+  change_event = CreateEvent(nullptr, false, false, nullptr);
+  if (change_event == nullptr || !InitializeCom()) {
+    control.state = windows::HostState::kFailed;
+    return 1;
+  }
+
+  // Shadow copies are named plugin.N.dll.
+  std::filesystem::path const dll = argv[3];
+  auto name = dll.stem().u8string();
+  name = name.substr(0, name.find('.'));
+
+  PluginSlot slot;
+  slot.sensor_host = { reinterpret_cast<void*>(uintptr_t{ 1 }), &AddSensor,
+    &SetSensorNumber, &SetSensorBool, &SetSensorString, &NotifyChanged };
+  auto profile_seq = channel.profiles().ReadLatest(plugin_profile);
+  if (profile_seq == 0)
+    plugin_profile.clear();
+  auto plugin = OpenPlugin(dll);
+  if (plugin == nullptr ||
+      !StartPlugin(name, slot, std::move(plugin), argv[4], false)) {
+    control.state = windows::HostState::kFailed;
+    CoUninitialize();
+    return 2;
+  }
+  control.state = windows::HostState::kRunning;
+  LOG(INFO) << "Hosting plugin " << name;
+
+  auto const period = static_cast<DWORD>(std::max(_wtoi(argv[5]), 1));
+  auto command_seq = channel.commands().last_seq();
+  auto profile = string2wstring(plugin_profile);
+  std::string values;
+  std::string published;
+  std::string command;
+  std::string next_profile;
+  HANDLE const handles[] = { wake, change_event };
+  while (!control.quit) {
+    // A profile that cannot be read yet is tried again on the next turn.
+    if (channel.profiles().last_seq() != profile_seq) {
+      if (auto const seq = channel.profiles().ReadLatest(next_profile);
+          seq != 0) {
+        profile_seq = seq;
+        plugin_profile = next_profile;
+        profile = string2wstring(plugin_profile);
+        if (auto const profile_changed = std::get<5>(*slot.plugin))
+          profile_changed(plugin_profile);
+      }
+    }
+
+    while (command_seq < channel.commands().last_seq()) {
+      if (channel.commands().Read(++command_seq, command) !=
+          core::ValueRing::ReadResult::kOk) {
+        LOG(ERROR) << "Lost command for " << name;
+        continue;
+      }
+
+      auto const execute_command = std::get<4>(*slot.plugin);
+      if (execute_command != nullptr && !execute_command(command))
+        LOG(ERROR) << "Error executing command " << command;
+    }
+
+    // Values that do not fit are reported once; the server then restarts
+    // the host with larger slots.
+    values.clear();
+    if (PollPlugin(slot, profile, values) && values != published) {
+      if (channel.values().Write(values)) {
+        control.state = windows::HostState::kRunning;
+        SetEvent(notify);
+      } else if (control.state != windows::HostState::kTooLarge) {
+        LOG(ERROR) << "Values of " << name << " do not fit shared memory, "
+                   << values.size() << " bytes";
+        control.values_needed =
+            static_cast<uint32_t>(std::min<size_t>(values.size(), UINT32_MAX));
+        control.state = windows::HostState::kTooLarge;
+      }
+      published.swap(values);
+    }
+
+    control.heartbeat++;
+    WaitForMultipleObjects(_countof(handles), handles, false, period);
+  }
+
+  ClosePlugin(name, slot);
+  CoUninitialize();
+  return 0;
+}
+
+}  // namespace
+
+int WINAPI wWinMain(HINSTANCE hInstance,
+    HINSTANCE hPrevInstance,
+    PWSTR pCmdLine,
+    int nCmdShow) {
+  int argc;
+  auto const argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+  if (argc > 1 && wcscmp(argv[1], windows::kPluginHostSwitch) == 0)
+    return RunPluginHost(argc, argv);
+
+  if (IsRunning(&instance_mutex)) {
+    LOG(ERROR) << "Another instance is already running";
     return 1;
   }
 
-  InitializeCriticalSection(&cs);
+  SetProcessAffinity();
 
-  json_data = std::make_unique<char[]>(current_size);
+  if (!CreateWindowResources(hInstance))
+    return 1;
+
+  SetMainCommandHandlers();
+
+  quit_event = CreateEvent(nullptr, true, false, nullptr);
+  change_event = CreateEvent(nullptr, false, false, nullptr);
+  if (quit_event == nullptr || change_event == nullptr) {
+    LOG(ERROR) << "Cannot create event. Err: " << GetLastError();
+    return 1;
+  }
+
+  if (!InitializeCom())
+    return 1;
 
   std::promise<int> running_promise;
   auto future = running_promise.get_future();
@@ -1398,8 +2501,8 @@ int WINAPI wWinMain(HINSTANCE hInstance,
   wait_future.join();
   LOG(INFO) << "Done waiting thread";
 
+  CloseHandle(change_event);
   CloseHandle(quit_event);
-  DeleteCriticalSection(&cs);
   CoUninitialize();
   return future.get();
 }
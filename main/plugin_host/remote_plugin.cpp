@@ -0,0 +1,452 @@
+/**
+ * Widget Sensors
+ * Out-of-process plugin host
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "plugin_host/remote_plugin.hpp"
+#include "shared/logger.hpp"
+#include <algorithm>
+
+namespace windows {
+namespace {
+constexpr wchar_t kMappingPrefix[] = L"Local\\widget_sensors.";
+
+// A host whose heartbeat does not move for this long is considered hung.
+constexpr DWORD kHangCheckMs = 1000;
+constexpr auto kHangTimeout = std::chrono::seconds(15);
+constexpr DWORD kStopTimeoutMs = 5000;
+// Restart delay after a crash, doubled on each crash in a row up to the
+// maximum. A host that ran for kStableRun starts over from the minimum.
+constexpr auto kRestartDelay = std::chrono::seconds(1);
+constexpr auto kMaxRestartDelay = std::chrono::seconds(60);
+constexpr auto kStableRun = std::chrono::minutes(1);
+
+constexpr size_t Align(size_t size) {
+  return (size + 63) & ~size_t{ 63 };
+}
+
+// Offsets in the shared memory, which depend on the value slot size.
+struct Layout {
+  explicit Layout(uint32_t value_slot_size)
+      : profiles(values + Align(core::ValueRing::RequiredSize(
+                              HostChannel::kValueSlots, value_slot_size))),
+        commands(profiles + Align(core::ValueRing::RequiredSize(
+                                HostChannel::kProfileSlots,
+                                HostChannel::kProfileSlotSize))),
+        size(commands + Align(core::ValueRing::RequiredSize(
+                            HostChannel::kCommandSlots,
+                            HostChannel::kCommandSlotSize))) {}
+
+  size_t const values = Align(sizeof(HostControl));
+  size_t const profiles;
+  size_t const commands;
+  size_t const size;
+};
+
+// Smallest power of two slot size that holds |needed| bytes.
+uint32_t GrowValueSlotSize(uint32_t current, uint32_t needed) {
+  auto size = std::max(current, HostChannel::kValueSlotSize);
+  while (size < needed && size < HostChannel::kMaxValueSlotSize)
+    size *= 2;
+
+  return size;
+}
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+              std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<HostState>::is_always_lock_free &&
+              std::atomic<bool>::is_always_lock_free);
+}  // namespace
+
+HostChannel::~HostChannel() {
+  if (view_)
+    UnmapViewOfFile(view_);
+
+  if (mapping_)
+    CloseHandle(mapping_);
+}
+
+bool HostChannel::Create(std::wstring const& name,
+    uint32_t value_slot_size) {
+  mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+      0, static_cast<DWORD>(Layout(value_slot_size).size), name.c_str());
+  if (mapping_ == nullptr) {
+    LOG(ERROR) << "Cannot create shared memory. Err: " << GetLastError();
+    return false;
+  }
+
+  return Map(true, value_slot_size);
+}
+
+bool HostChannel::Open(std::wstring const& name) {
+  mapping_ = OpenFileMappingW(FILE_MAP_ALL_ACCESS, false, name.c_str());
+  if (mapping_ == nullptr) {
+    LOG(ERROR) << "Cannot open shared memory. Err: " << GetLastError();
+    return false;
+  }
+
+  return Map(false, 0);
+}
+
+// Maps the whole memory. The host learns the value slot size from the
+// control block, which the server filled in when it created the memory.
+bool HostChannel::Map(bool init, uint32_t value_slot_size) {
+  view_ = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if (view_ == nullptr) {
+    LOG(ERROR) << "Cannot map shared memory. Err: " << GetLastError();
+    return false;
+  }
+
+  auto* const base = static_cast<char*>(view_);
+  control_ = reinterpret_cast<HostControl*>(base);
+  if (init) {
+    control_->value_slot_size = value_slot_size;
+    control_->values_needed = 0;
+  } else {
+    value_slot_size = control_->value_slot_size;
+  }
+
+  Layout const layout(value_slot_size);
+  values_ = core::ValueRing(
+      base + layout.values, kValueSlots, value_slot_size, init);
+  profiles_ = core::ValueRing(
+      base + layout.profiles, kProfileSlots, kProfileSlotSize, init);
+  commands_ = core::ValueRing(
+      base + layout.commands, kCommandSlots, kCommandSlotSize, init);
+  return true;
+}
+
+RemotePlugin::RemotePlugin(std::string name,
+    std::filesystem::path data_dir,
+    std::chrono::milliseconds period,
+    HANDLE notify_event)
+    : name_(std::move(name)),
+      data_dir_(std::move(data_dir)),
+      period_(period),
+      notify_event_(notify_event) {
+  wake_event_ = CreateEvent(nullptr, false, false, nullptr);
+  stop_event_ = CreateEvent(nullptr, true, false, nullptr);
+  restart_event_ = CreateEvent(nullptr, false, false, nullptr);
+
+  // Hosts go away with the server, even if it crashes.
+  job_ = CreateJobObjectW(nullptr, nullptr);
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+  limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+  if (job_ == nullptr || !SetInformationJobObject(job_,
+                             JobObjectExtendedLimitInformation, &limits,
+                             sizeof(limits)))
+    LOG(ERROR) << "Cannot set up job object. Err: " << GetLastError();
+}
+
+RemotePlugin::~RemotePlugin() {
+  Stop();
+
+  for (auto const h : { wake_event_, stop_event_, restart_event_, job_ }) {
+    if (h)
+      CloseHandle(h);
+  }
+}
+
+bool RemotePlugin::Start(std::filesystem::path dll) {
+  if (wake_event_ == nullptr || stop_event_ == nullptr ||
+      restart_event_ == nullptr)
+    return false;
+
+  if (!CreateChannel(HostChannel::kValueSlotSize))
+    return false;
+
+  dll_ = std::move(dll);
+  supervisor_ = std::thread(&RemotePlugin::Supervise, this);
+  return true;
+}
+
+void RemotePlugin::Restart(std::filesystem::path dll) {
+  {
+    std::lock_guard lock(mutex_);
+    std::error_code ec;
+    if (!next_dll_.empty())
+      std::filesystem::remove(next_dll_, ec);
+
+    next_dll_ = std::move(dll);
+  }
+  SetEvent(restart_event_);
+}
+
+void RemotePlugin::Stop() {
+  if (!supervisor_.joinable())
+    return;
+
+  SetEvent(stop_event_);
+  supervisor_.join();
+
+  std::error_code ec;
+  std::filesystem::remove(dll_, ec);
+  if (!next_dll_.empty())
+    std::filesystem::remove(next_dll_, ec);
+}
+
+bool RemotePlugin::Read(std::string& out) {
+  auto const seq = channel()->values().ReadLatest(out);
+  if (seq == 0)
+    return false;
+
+  read_seq_ = seq;
+  return true;
+}
+
+bool RemotePlugin::HasNewValues() const {
+  return channel()->values().last_seq() != read_seq_;
+}
+
+void RemotePlugin::SetProfile(std::string_view profile) {
+  std::lock_guard lock(mutex_);
+  profile_ = profile;
+  if (!channel_->profiles().Write(profile)) {
+    LOG(ERROR) << "Profile too long for plugin host of " << name_;
+    return;
+  }
+
+  SetEvent(wake_event_);
+}
+
+bool RemotePlugin::ExecuteCommand(std::string_view command) {
+  std::lock_guard lock(mutex_);
+  if (!channel_->commands().Write(command))
+    return false;
+
+  SetEvent(wake_event_);
+  return true;
+}
+
+// Memory is named after the server process, the plugin and a counter, as
+// the previous channel may still be open while the next one is created.
+bool RemotePlugin::CreateChannel(uint32_t value_slot_size) {
+  std::lock_guard lock(mutex_);
+  auto const name = kMappingPrefix + std::to_wstring(GetCurrentProcessId()) +
+                    L"." + std::filesystem::path(name_).native() + L"." +
+                    std::to_wstring(channels_++);
+  auto channel = std::make_shared<HostChannel>();
+  if (!channel->Create(name, value_slot_size))
+    return false;
+
+  if (!profile_.empty())
+    channel->profiles().Write(profile_);
+
+  channel_name_ = name;
+  read_seq_ = 0;
+  std::atomic_store(&channel_, std::move(channel));
+  return true;
+}
+
+bool RemotePlugin::Spawn() {
+  std::wstring exe(MAX_PATH, L'\0');
+  exe.resize(GetModuleFileNameW(nullptr, exe.data(),
+      static_cast<DWORD>(exe.size())));
+
+  std::wstring cmdline;
+  {
+    std::lock_guard lock(mutex_);
+    cmdline = L"\"" + exe + L"\" " + kPluginHostSwitch + L" \"" +
+              channel_name_ + L"\" \"" + dll_.native() + L"\" \"" +
+              data_dir_.native() + L"\" " + std::to_wstring(period_.count());
+  }
+
+  auto& control = channel_->control();
+  control.heartbeat = 0;
+  control.state = HostState::kStarting;
+  control.quit = false;
+
+  STARTUPINFOW si{};
+  si.cb = sizeof(si);
+  PROCESS_INFORMATION pi{};
+  if (!CreateProcessW(exe.c_str(), cmdline.data(), nullptr, nullptr, false,
+          CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi)) {
+    LOG(ERROR) << "Cannot start plugin host of " << name_
+               << ". Err: " << GetLastError();
+    return false;
+  }
+
+  if (job_ && !AssignProcessToJobObject(job_, pi.hProcess))
+    LOG(ERROR) << "Cannot add plugin host to job. Err: " << GetLastError();
+
+  HANDLE notify{};
+  HANDLE wake{};
+  auto const self = GetCurrentProcess();
+  if (!DuplicateHandle(self, notify_event_, pi.hProcess, &notify,
+          EVENT_MODIFY_STATE, false, 0) ||
+      !DuplicateHandle(self, wake_event_, pi.hProcess, &wake, SYNCHRONIZE,
+          false, 0)) {
+    LOG(ERROR) << "Cannot share events with plugin host. Err: "
+               << GetLastError();
+    TerminateProcess(pi.hProcess, 1);
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+    return false;
+  }
+  control.notify_event = reinterpret_cast<uint64_t>(notify);
+  control.wake_event = reinterpret_cast<uint64_t>(wake);
+
+  ResumeThread(pi.hThread);
+  CloseHandle(pi.hThread);
+  process_ = pi.hProcess;
+  LOG(INFO) << "Started plugin host of " << name_ << " PID: " << pi.dwProcessId;
+  return true;
+}
+
+void RemotePlugin::StopHost() {
+  channel_->control().quit = true;
+  SetEvent(wake_event_);
+  if (WaitForSingleObject(process_, kStopTimeoutMs) != WAIT_OBJECT_0) {
+    LOG(ERROR) << "Plugin host of " << name_ << " did not stop, killing it";
+    TerminateProcess(process_, 1);
+    WaitForSingleObject(process_, INFINITE);
+  }
+}
+
+void RemotePlugin::Supervise() {
+  std::chrono::milliseconds delay = kRestartDelay;
+  for (;;) {
+    auto const started = std::chrono::steady_clock::now();
+    bool restart = false;
+    bool failed = false;
+    uint32_t grow_to{};
+    if (Spawn()) {
+      auto& control = channel_->control();
+      bool too_large = false;
+      uint64_t heartbeat{};
+      auto progress = started;
+      HANDLE handles[] = { stop_event_, restart_event_, process_ };
+      for (;;) {
+        auto const res = WaitForMultipleObjects(
+            _countof(handles), handles, false, kHangCheckMs);
+        if (res == WAIT_OBJECT_0) {
+          StopHost();
+          CloseHandle(process_);
+          process_ = nullptr;
+          return;
+        }
+
+        if (res == WAIT_OBJECT_0 + 1) {
+          StopHost();
+          restart = true;
+          break;
+        }
+
+        if (res == WAIT_OBJECT_0 + 2) {
+          DWORD code{};
+          GetExitCodeProcess(process_, &code);
+          failed = control.state == HostState::kFailed;
+          LOG(ERROR) << "Plugin host of " << name_ << " exited. Code: "
+                     << code;
+          break;
+        }
+
+        // Values that outgrew the slots are published again by a host with
+        // larger ones. Beyond the maximum, the plugin stays in kTooLarge.
+        if (control.state == HostState::kTooLarge && !too_large) {
+          too_large = true;
+          auto const needed = control.values_needed.load();
+          auto const size =
+              GrowValueSlotSize(control.value_slot_size, needed);
+          if (size >= needed) {
+            LOG(INFO) << "Values of " << name_ << " need " << needed
+                      << " bytes, growing shared memory to " << size;
+            StopHost();
+            grow_to = size;
+            break;
+          }
+
+          LOG(ERROR) << "Values of " << name_ << " need " << needed
+                     << " bytes, more than the maximum of "
+                     << HostChannel::kMaxValueSlotSize;
+        } else if (control.state == HostState::kRunning) {
+          too_large = false;
+        }
+
+        // Initialization can take a while, only a started host has to keep
+        // its heartbeat going.
+        auto const now = std::chrono::steady_clock::now();
+        auto const beat = control.heartbeat.load();
+        if (beat != heartbeat || control.state == HostState::kStarting) {
+          heartbeat = beat;
+          progress = now;
+        } else if (now - progress > kHangTimeout) {
+          LOG(ERROR) << "Plugin host of " << name_ << " stopped responding";
+          TerminateProcess(process_, 1);
+          WaitForSingleObject(process_, INFINITE);
+          break;
+        }
+      }
+
+      CloseHandle(process_);
+      process_ = nullptr;
+    }
+
+    if (grow_to != 0 && CreateChannel(grow_to)) {
+      delay = kRestartDelay;
+      continue;
+    }
+
+    // A new DLL replaces the current one once its host is gone.
+    if (TakeNextDll() || restart) {
+      delay = kRestartDelay;
+      continue;
+    }
+
+    // A plugin that refuses to initialize is not retried until it is
+    // replaced.
+    HANDLE handles[] = { stop_event_, restart_event_ };
+    DWORD wait = INFINITE;
+    if (!failed) {
+      restarts_++;
+      if (std::chrono::steady_clock::now() - started > kStableRun)
+        delay = kRestartDelay;
+
+      wait = static_cast<DWORD>(delay.count());
+      delay = std::min<std::chrono::milliseconds>(delay * 2, kMaxRestartDelay);
+    } else {
+      LOG(ERROR) << "Plugin " << name_ << " could not be initialized";
+    }
+
+    auto const res =
+        WaitForMultipleObjects(_countof(handles), handles, false, wait);
+    if (res == WAIT_OBJECT_0)
+      return;
+
+    if (res == WAIT_OBJECT_0 + 1)
+      TakeNextDll();
+  }
+}
+
+bool RemotePlugin::TakeNextDll() {
+  std::lock_guard lock(mutex_);
+  if (next_dll_.empty())
+    return false;
+
+  std::error_code ec;
+  std::filesystem::remove(dll_, ec);
+  dll_ = std::move(next_dll_);
+  next_dll_.clear();
+  return true;
+}
+}  // namespace windows
@@ -0,0 +1,199 @@
+/**
+ * Widget Sensors
+ * Out-of-process plugin host
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "shared/platform.hpp"
+#include "core/value_ring.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace windows {
+// First argument of a server started as a plugin host.
+constexpr wchar_t kPluginHostSwitch[] = L"--plugin-host";
+
+// kTooLarge: the host runs, but the plugin's values do not fit the value
+// slots, see HostControl::values_needed.
+enum class HostState : uint32_t { kStarting, kRunning, kFailed, kTooLarge };
+
+// Start of the memory shared with a plugin host process. Event handles are
+// duplicated into the host by the server before the host starts running.
+struct HostControl {
+  std::atomic<uint64_t> heartbeat;
+  std::atomic<HostState> state;
+  std::atomic<bool> quit;
+  // Set by the host when it wrote new values.
+  uint64_t notify_event;
+  // Set by the server when there is a new profile, command or quit request.
+  uint64_t wake_event;
+  // Size of a value slot, set by the server when it creates the memory.
+  uint32_t value_slot_size;
+  // Size of the values that did not fit, set by the host along with
+  // kTooLarge.
+  std::atomic<uint32_t> values_needed;
+};
+
+// Memory shared between the server and a plugin host: the control block, the
+// plugin's values written by the host, and the profile changes and commands
+// written by the server.
+class HostChannel {
+public:
+  static constexpr uint32_t kValueSlots = 4;
+  // Value slots start at kValueSlotSize and grow up to kMaxValueSlotSize
+  // for plugins that write more.
+  static constexpr uint32_t kValueSlotSize = 64 * 1024;
+  static constexpr uint32_t kMaxValueSlotSize = 16 * 1024 * 1024;
+  static constexpr uint32_t kProfileSlots = 4;
+  static constexpr uint32_t kProfileSlotSize = 1024;
+  static constexpr uint32_t kCommandSlots = 8;
+  static constexpr uint32_t kCommandSlotSize = 4096;
+
+  HostChannel() = default;
+  ~HostChannel();
+
+  HostChannel(HostChannel const&) = delete;
+  HostChannel& operator=(HostChannel const&) = delete;
+
+  // Server side, creates and formats the shared memory.
+  bool Create(std::wstring const& name,
+      uint32_t value_slot_size = kValueSlotSize);
+  // Host side, the layout is read from the control block.
+  bool Open(std::wstring const& name);
+
+  [[nodiscard]] HostControl& control() const {
+    return *control_;
+  }
+
+  [[nodiscard]] core::ValueRing& values() {
+    return values_;
+  }
+
+  [[nodiscard]] core::ValueRing const& values() const {
+    return values_;
+  }
+
+  [[nodiscard]] core::ValueRing& profiles() {
+    return profiles_;
+  }
+
+  [[nodiscard]] core::ValueRing& commands() {
+    return commands_;
+  }
+
+private:
+  bool Map(bool init, uint32_t value_slot_size);
+
+  HANDLE mapping_{};
+  void* view_{};
+  HostControl* control_{};
+  core::ValueRing values_;
+  core::ValueRing profiles_;
+  core::ValueRing commands_;
+};
+
+// Server side of a plugin running in a host process, which is a copy of the
+// server started with --plugin-host. The host polls the plugin on its own and
+// publishes the values to shared memory, so reading them costs no system
+// call. A host that exits or stops making progress is restarted, with a
+// growing delay if it keeps failing. Hosts are killed with the server. A host
+// whose values outgrow the shared memory is restarted with larger slots.
+class RemotePlugin {
+public:
+  RemotePlugin(std::string name,
+      std::filesystem::path data_dir,
+      std::chrono::milliseconds period,
+      HANDLE notify_event);
+  ~RemotePlugin();
+
+  RemotePlugin(RemotePlugin const&) = delete;
+  RemotePlugin& operator=(RemotePlugin const&) = delete;
+
+  // Runs the plugin DLL at |dll| in a host process. The plugin takes over
+  // |dll| and deletes it once no host uses it anymore.
+  bool Start(std::filesystem::path dll);
+  // Replaces the host with one running |dll|. The last values are served
+  // until the new host publishes its own.
+  void Restart(std::filesystem::path dll);
+  void Stop();
+
+  // Copies the newest values of the plugin to |out|. Returns false if the
+  // host did not publish any yet. Can be called from any thread.
+  bool Read(std::string& out);
+  [[nodiscard]] bool HasNewValues() const;
+
+  void SetProfile(std::string_view profile);
+  bool ExecuteCommand(std::string_view command);
+
+  // State of the current host. Only valid once Start() succeeded.
+  [[nodiscard]] HostState state() const {
+    return channel()->control().state;
+  }
+
+  [[nodiscard]] uint32_t restarts() const {
+    return restarts_;
+  }
+
+private:
+  // The channel is replaced when the value slots grow, readers keep the one
+  // they got until they are done with it.
+  [[nodiscard]] std::shared_ptr<HostChannel> channel() const {
+    return std::atomic_load(&channel_);
+  }
+
+  bool CreateChannel(uint32_t value_slot_size);
+  bool Spawn();
+  void Supervise();
+  void StopHost();
+  // Switches to the DLL given to Restart(), if any.
+  bool TakeNextDll();
+
+  std::string name_;
+  std::filesystem::path data_dir_;
+  std::chrono::milliseconds period_{};
+  HANDLE notify_event_{};
+  std::shared_ptr<HostChannel> channel_;
+  std::wstring channel_name_;
+  uint32_t channels_{};  // Channels created, to name the next one.
+  std::string profile_;  // Written again to each new channel.
+  HANDLE wake_event_{};
+  HANDLE stop_event_{};
+  HANDLE restart_event_{};
+  HANDLE job_{};
+  HANDLE process_{};
+  std::thread supervisor_;
+  // Guards |dll_|, |next_dll_|, |channel_name_|, |profile_| and the
+  // server's rings.
+  std::mutex mutex_;
+  std::filesystem::path dll_;
+  std::filesystem::path next_dll_;
+  std::atomic<uint64_t> read_seq_{};
+  std::atomic<uint32_t> restarts_{};
+};
+}  // namespace windows
@@ -28,6 +28,25 @@
 #define RTSS_VERSION(x, y) ((x << 16) + y)
 
 namespace rtss {
+namespace {
+// Leaves the critical section when going out of scope.
+class CriticalSectionLock {
+public:
+  explicit CriticalSectionLock(CRITICAL_SECTION& cs) : cs_(cs) {
+    EnterCriticalSection(&cs_);
+  }
+  ~CriticalSectionLock() {
+    LeaveCriticalSection(&cs_);
+  }
+
+  CriticalSectionLock(CriticalSectionLock const&) = delete;
+  CriticalSectionLock& operator=(CriticalSectionLock const&) = delete;
+
+private:
+  CRITICAL_SECTION& cs_;
+};
+}  // namespace
+
 RTSSSharedMemory::RTSSSharedMemory() {
   InitializeCriticalSection(&cs_);
   current_process_ = std::make_pair(0, rtss_entry_t{});
@@ -80,17 +99,23 @@ void RTSSSharedMemory::Update() {
 }
 
 std::string RTSSSharedMemory::GetCurrentProcessName() const {
-  EnterCriticalSection(&cs_);
-  auto leave_critical_section = [this] { LeaveCriticalSection(&cs_); };
+  CriticalSectionLock lock(cs_);
   if (current_process_.first == 0)
     return {};
 
   return current_process_.second.szName;
 }
 
+void RTSSSharedMemory::GetCurrentProcessName(std::string& name) const {
+  CriticalSectionLock lock(cs_);
+  if (current_process_.first == 0)
+    name.clear();
+  else
+    name.assign(current_process_.second.szName);
+}
+
 rtss_entry_t RTSSSharedMemory::GetEntry() {
-  EnterCriticalSection(&cs_);
-  auto leave_critical_section = [this] { LeaveCriticalSection(&cs_); };
+  CriticalSectionLock lock(cs_);
   auto const target_pid = GetCurrentProcessPid();
   if (target_pid == 0)
     return {};
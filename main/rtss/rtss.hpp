@@ -44,6 +44,7 @@ public:
   std::pair<double, double> GetFramerate();
   std::pair<double, double> GetFrametime();
   std::string GetCurrentProcessName() const;
+  void GetCurrentProcessName(std::string& name) const;
   auto IsReady() const noexcept {
     return ready_.load();
   }
@@ -0,0 +1,103 @@
+/**
+ * Widget Sensors
+ * Websocket server configuration
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#ifdef USE_PERMESSAGE_DEFLATE
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#endif
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace network {
+// Compression counters of a connection. |bytes_in| and |bytes_out| only
+// count messages that went through permessage-deflate.
+struct CompressionStats {
+  uint64_t messages{};
+  uint64_t compressed_messages{};
+  uint64_t bytes_in{};
+  uint64_t bytes_out{};
+  std::chrono::nanoseconds compress_time{};
+
+  [[nodiscard]] double ratio() const {
+    return bytes_in > 0 ? static_cast<double>(bytes_out) / bytes_in : 1.0;
+  }
+};
+
+#ifdef USE_PERMESSAGE_DEFLATE
+// The extension object lives inside the connection processor, so the stats
+// of the connection being written to are handed over through |current|,
+// which WebsocketServer::Send() sets around each send.
+template<typename config>
+class timed_deflate
+    : public websocketpp::extensions::permessage_deflate::enabled<config> {
+public:
+  using base = websocketpp::extensions::permessage_deflate::enabled<config>;
+
+  static inline thread_local CompressionStats* current = nullptr;
+
+  websocketpp::lib::error_code compress(std::string const& in,
+      std::string& out) {
+    auto const start = std::chrono::steady_clock::now();
+    auto const size = out.size();
+    auto const ec = base::compress(in, out);
+    if (current != nullptr) {
+      current->compressed_messages++;
+      current->bytes_in += in.size();
+      current->bytes_out += out.size() - size;
+      current->compress_time += std::chrono::steady_clock::now() - start;
+    }
+    return ec;
+  }
+};
+#endif
+
+// websocketpp::config::asio with permessage-deflate enabled when built with
+// zlib. Whether a connection is compressed is negotiated with each client.
+// Context takeover is kept unless the client asks otherwise, so key names
+// repeated across frames compress to a few bytes.
+struct server_config : public websocketpp::config::asio {
+  typedef server_config type;
+  typedef websocketpp::config::asio base;
+
+  typedef base::concurrency_type concurrency_type;
+  typedef base::request_type request_type;
+  typedef base::response_type response_type;
+  typedef base::message_type message_type;
+  typedef base::con_msg_manager_type con_msg_manager_type;
+  typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+  typedef base::alog_type alog_type;
+  typedef base::elog_type elog_type;
+  typedef base::rng_type rng_type;
+  typedef base::transport_type transport_type;
+
+#ifdef USE_PERMESSAGE_DEFLATE
+  struct permessage_deflate_config {};
+  typedef timed_deflate<permessage_deflate_config> permessage_deflate_type;
+#endif
+};
+}  // namespace network
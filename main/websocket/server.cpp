@@ -24,9 +24,16 @@
  * SOFTWARE.
  */
 #include "websocket/server.hpp"
+#include <algorithm>
 #include <cassert>
+#include <optional>
 
 namespace network {
+namespace {
+// How often a connection still writing is checked for a pending push.
+constexpr auto kFlushInterval = std::chrono::milliseconds(20);
+}  // namespace
+
 using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
@@ -40,6 +47,7 @@ WebsocketServer::WebsocketServer(unsigned port) : port_(port) {
   server_.set_access_channels(websocketpp::log::elevel::info);
 
   // Register handler callbacks
+  server_.set_validate_handler(bind(&WebsocketServer::OnValidate, this, _1));
   server_.set_open_handler(bind(&WebsocketServer::OnOpen, this, _1));
   server_.set_close_handler(bind(&WebsocketServer::OnClose, this, _1));
   server_.set_message_handler(bind(&WebsocketServer::OnMessage, this, _1, _2));
@@ -49,10 +57,14 @@ WebsocketServer::~WebsocketServer() {
   runner_.join();
 }
 
-bool WebsocketServer::Start(message_handler_t on_message) {
+bool WebsocketServer::Start(message_handler_t on_message,
+    close_handler_t on_close,
+    open_handler_t on_open) {
   assert(on_message != nullptr);
 
   on_message_ = std::move(on_message);
+  on_close_ = std::move(on_close);
+  on_open_ = std::move(on_open);
   server_.listen(port_);
   server_.start_accept();
 
@@ -66,27 +78,307 @@ bool WebsocketServer::Start(message_handler_t on_message) {
   return true;
 }
 
-bool WebsocketServer::Send(connection_hdl hdl, const char* data, size_t size) {
+bool WebsocketServer::Send(connection_hdl hdl,
+    const char* data,
+    size_t size,
+    bool binary) {
+  auto const msg = std::make_shared<server_t::message_type>(nullptr,
+      binary ? websocketpp::frame::opcode::BINARY
+             : websocketpp::frame::opcode::TEXT,
+      size);
+  msg->append_payload(data, size);
+  msg->set_compressed(size >= compression_threshold_);
+  return Send(hdl, msg);
+}
+
+bool WebsocketServer::Send(connection_hdl hdl, Payload const& payload) {
+  return Send(hdl, payload.data.data(), payload.data.size(), payload.binary);
+}
+
+bool WebsocketServer::Send(connection_hdl hdl,
+    server_t::message_ptr const& msg) {
+  auto it = connections_.find(hdl);
+  auto* const stats =
+      it != connections_.end() ? &it->second.compression : nullptr;
+  if (stats != nullptr)
+    stats->messages++;
+
   try {
-    server_.send(hdl, data, size, websocketpp::frame::opcode::TEXT);
+    auto const con = server_.get_con_from_hdl(hdl);
+#ifdef USE_PERMESSAGE_DEFLATE
+    using deflate_t = server_config::permessage_deflate_type;
+    deflate_t::current = stats;
+    auto const ec = con->send(msg);
+    deflate_t::current = nullptr;
+#else
+    auto const ec = con->send(msg);
+#endif
+    if (!ec)
+      return true;
+  } catch (...) {
+  }
+
+  std::cout << "Cannot send " << msg->get_payload().size() << " bytes"
+            << std::endl;
+  return false;
+}
+
+server_t::message_ptr WebsocketServer::Prepare(Payload const& payload) {
+  auto const op = payload.binary ? websocketpp::frame::opcode::BINARY
+                                 : websocketpp::frame::opcode::TEXT;
+  auto const size = payload.data.size();
+  auto const msg = std::make_shared<server_t::message_type>(nullptr, op, size);
+  msg->append_payload(payload.data.data(), size);
+  msg->set_header(websocketpp::frame::prepare_header(
+      websocketpp::frame::basic_header(op, size, true, false),
+      websocketpp::frame::extended_header(size)));
+  msg->set_prepared(true);
+  return msg;
+}
+
+bool WebsocketServer::CanSharePayload(connection_hdl hdl, size_t size) {
+  auto it = connections_.find(hdl);
+  return it != connections_.end() &&
+         (!it->second.deflate || size < compression_threshold_);
+}
+
+void WebsocketServer::Subscribe(connection_hdl hdl,
+    std::chrono::milliseconds min_interval) {
+  auto& s = subscriptions_[hdl];
+  s.min_interval = min_interval;
+  s.last_push = {};
+  subscriber_count_ = subscriptions_.size();
+}
+
+void WebsocketServer::Unsubscribe(connection_hdl hdl) {
+  subscriptions_.erase(hdl);
+  if (auto it = connections_.find(hdl); it != connections_.end())
+    it->second.pending = nullptr;
+
+  subscriber_count_ = subscriptions_.size();
+}
+
+void WebsocketServer::Publish(payload_provider_t provider) {
+  if (subscriber_count_ == 0)
+    return;
+
+  auto shared = std::make_shared<const payload_provider_t>(std::move(provider));
+  asio::post(server_.get_io_service(), [this, provider = std::move(shared)] {
+    auto const now = clock_t::now();
+    // Frames built so far, one per distinct payload. Payloads are told apart
+    // by address as the provider hands out the same buffer to clients that
+    // should get the same bytes.
+    prepared_list_t prepared;
+    for (auto& [hdl, s] : subscriptions_) {
+      // A subscriber within its interval gets the latest frame once it is
+      // over, so that the last change is never lost.
+      if (auto const due = s.last_push + s.min_interval; now < due) {
+        Defer(hdl, provider, due);
+        continue;
+      }
+
+      if (IsBusy(hdl)) {
+        Defer(hdl, provider, now + kFlushInterval);
+        continue;
+      }
+
+      // A frame still held back is older than this one.
+      if (auto c = connections_.find(hdl); c != connections_.end())
+        c->second.pending = nullptr;
+
+      if (Push(hdl, *provider, prepared))
+        s.last_push = now;
+    }
+  });
+}
+
+bool WebsocketServer::Push(connection_hdl hdl,
+    payload_provider_t const& provider,
+    prepared_list_t& prepared) {
+  auto const payload = provider(hdl);
+  if (payload.data.empty())
+    return false;
+
+  if (!CanSharePayload(hdl, payload.data.size())) {
+    Send(hdl, payload);
     return true;
+  }
+
+  auto it = std::find_if(prepared.begin(), prepared.end(), [&](auto& p) {
+    return p.first.data.data() == payload.data.data() &&
+           p.first.data.size() == payload.data.size() &&
+           p.first.binary == payload.binary;
+  });
+  if (it == prepared.end())
+    it = prepared.insert(prepared.end(), { payload, Prepare(payload) });
+
+  Send(hdl, it->second);
+  return true;
+}
+
+bool WebsocketServer::IsBusy(connection_hdl hdl) {
+  try {
+    return server_.get_con_from_hdl(hdl)->get_buffered_amount() > 0;
   } catch (...) {
-    std::cout << "Cannot send " << size << " bytes" << std::endl;
     return false;
   }
 }
 
+void WebsocketServer::Defer(connection_hdl hdl,
+    shared_provider_t const& provider,
+    clock_t::time_point due) {
+  auto it = connections_.find(hdl);
+  if (it == connections_.end())
+    return;
+
+  auto& c = it->second;
+  if (c.pending != nullptr)
+    c.dropped++;
+
+  c.pending = provider;
+  ScheduleFlush(due);
+}
+
+// A single timer is armed for the earliest pending push. A timer superseded
+// by an earlier one does nothing when it fires.
+void WebsocketServer::ScheduleFlush(clock_t::time_point due) {
+  if (flush_scheduled_ && flush_due_ <= due)
+    return;
+
+  flush_scheduled_ = true;
+  flush_due_ = due;
+  auto const delay = std::chrono::ceil<std::chrono::milliseconds>(
+      due - clock_t::now());
+  server_.set_timer(std::max<long>(static_cast<long>(delay.count()), 0),
+      [this, due](auto const& ec) {
+        if (ec || !flush_scheduled_ || due != flush_due_)
+          return;
+
+        flush_scheduled_ = false;
+        Flush();
+      });
+}
+
+void WebsocketServer::Flush() {
+  auto const now = clock_t::now();
+  prepared_list_t prepared;
+  std::optional<clock_t::time_point> next;
+  auto const wait_until = [&](clock_t::time_point due) {
+    next = next.has_value() ? std::min(*next, due) : due;
+  };
+  for (auto& [hdl, c] : connections_) {
+    if (c.pending == nullptr)
+      continue;
+
+    auto s = subscriptions_.find(hdl);
+    if (s == subscriptions_.end()) {
+      c.pending = nullptr;
+      continue;
+    }
+
+    if (auto const due = s->second.last_push + s->second.min_interval;
+        now < due) {
+      wait_until(due);
+      continue;
+    }
+
+    if (IsBusy(hdl)) {
+      wait_until(now + kFlushInterval);
+      continue;
+    }
+
+    auto const provider = std::move(c.pending);
+    c.pending = nullptr;
+    if (Push(hdl, *provider, prepared))
+      s->second.last_push = now;
+  }
+
+  if (next.has_value())
+    ScheduleFlush(*next);
+}
+
+void WebsocketServer::Broadcast(Payload payload) {
+  Publish([payload = std::move(payload)](connection_hdl) { return payload; });
+}
+
+void WebsocketServer::SetSubprotocols(std::vector<std::string> subprotocols) {
+  subprotocols_ = std::move(subprotocols);
+}
+
+std::string WebsocketServer::GetSubprotocol(connection_hdl hdl) {
+  try {
+    return server_.get_con_from_hdl(hdl)->get_subprotocol();
+  } catch (...) {
+    return {};
+  }
+}
+
+void WebsocketServer::SetCompressionThreshold(size_t threshold) {
+  compression_threshold_ = threshold;
+}
+
+bool WebsocketServer::IsCompressed(connection_hdl hdl) {
+  auto it = connections_.find(hdl);
+  return it != connections_.end() && it->second.deflate;
+}
+
+CompressionStats WebsocketServer::GetCompressionStats(connection_hdl hdl) {
+  auto it = connections_.find(hdl);
+  return it != connections_.end() ? it->second.compression
+                                   : CompressionStats{};
+}
+
+SendStats WebsocketServer::GetSendStats(connection_hdl hdl) {
+  SendStats stats;
+  if (auto it = connections_.find(hdl); it != connections_.end())
+    stats.dropped = it->second.dropped;
+
+  try {
+    stats.buffered_bytes = server_.get_con_from_hdl(hdl)->get_buffered_amount();
+  } catch (...) {
+  }
+  return stats;
+}
+
 void WebsocketServer::Shutdown() {
   server_.stop_listening();
   server_.stop();
 }
 
+bool WebsocketServer::OnValidate(connection_hdl hdl) {
+  auto const con = server_.get_con_from_hdl(hdl);
+  for (auto const& requested : con->get_requested_subprotocols()) {
+    if (std::find(subprotocols_.begin(), subprotocols_.end(), requested) !=
+        subprotocols_.end()) {
+      con->select_subprotocol(requested);
+      break;
+    }
+  }
+  return true;
+}
+
 void WebsocketServer::OnOpen(connection_hdl hdl) {
   std::cout << "Client connection opened" << std::endl;
+  connections_[hdl] = {};
+#ifdef USE_PERMESSAGE_DEFLATE
+  try {
+    auto const con = server_.get_con_from_hdl(hdl);
+    connections_[hdl].deflate =
+        con->get_response_header("Sec-WebSocket-Extensions")
+            .find("permessage-deflate") != std::string::npos;
+  } catch (...) {
+  }
+#endif
+  if (on_open_)
+    on_open_(hdl);
 }
 
 void WebsocketServer::OnClose(connection_hdl hdl) {
   std::cout << "Client connection closed" << std::endl;
+  Unsubscribe(hdl);
+  connections_.erase(hdl);
+  if (on_close_)
+    on_close_(hdl);
 }
 
 void WebsocketServer::OnMessage(connection_hdl hdl, server_t::message_ptr msg) {
@@ -25,18 +25,42 @@
  */
 #pragma once
 
-#include <websocketpp/config/asio_no_tls.hpp>
+#include "websocket/config.hpp"
 #include <websocketpp/server.hpp>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <string>
+#include <string_view>
 
 namespace network {
-typedef websocketpp::server<websocketpp::config::asio> server_t;
+typedef websocketpp::server<server_config> server_t;
 using websocketpp::connection_hdl;
 using message_handler_t = std::function<void(connection_hdl hdl,
     const std::string&)>;
+using close_handler_t = std::function<void(connection_hdl hdl)>;
+using open_handler_t = std::function<void(connection_hdl hdl)>;
+
+// Bytes to be sent to a client. |owner| keeps |data| alive until the payload
+// is handed over to the connection. |binary| payloads go out as binary frames.
+struct Payload {
+  std::shared_ptr<const void> owner;
+  std::string_view data;
+  bool binary{};
+};
+using payload_provider_t = std::function<Payload(connection_hdl hdl)>;
+
+// Push delivery counters of a connection. |dropped| counts frames that were
+// replaced by a newer one before the connection could take them, because it
+// was still writing or within its minimum interval.
+struct SendStats {
+  uint64_t dropped{};
+  size_t buffered_bytes{};
+};
 
 class WebsocketServer {
 public:
@@ -45,18 +69,107 @@ public:
   explicit WebsocketServer(unsigned port);
   ~WebsocketServer();
 
-  bool Start(message_handler_t on_message);
-  bool Send(connection_hdl hdl, const char* data, size_t size);
+  bool Start(message_handler_t on_message,
+      close_handler_t on_close = nullptr,
+      open_handler_t on_open = nullptr);
+  bool Send(connection_hdl hdl,
+      const char* data,
+      size_t size,
+      bool binary = false);
+  bool Send(connection_hdl hdl, Payload const& payload);
   void Shutdown();
 
+  // Push mode. Subscribed clients get a frame every time Publish() is called,
+  // but not more often than |min_interval|: a frame published sooner is held
+  // back, replaced by any newer one, and sent once the interval is over.
+  // Subscribe() and Unsubscribe() must be called from a message handler.
+  void Subscribe(connection_hdl hdl, std::chrono::milliseconds min_interval);
+  void Unsubscribe(connection_hdl hdl);
+
+  // Can be called from any thread. |provider| is invoked on the server thread
+  // once for each subscriber that is due for an update. Empty payloads are
+  // not sent. Subscribers given the same payload share a single websocket
+  // frame, built once, unless their connection compresses it.
+  // A subscriber still writing the previous frame gets at most one more,
+  // from the latest provider, once the connection has drained.
+  void Publish(payload_provider_t provider);
+
+  // Sends |payload| to every subscriber that is due for an update.
+  void Broadcast(Payload payload);
+
+  // Sec-WebSocket-Protocol values the server accepts, in order of preference
+  // of the client. Must be set before Start().
+  void SetSubprotocols(std::vector<std::string> subprotocols);
+  [[nodiscard]] std::string GetSubprotocol(connection_hdl hdl);
+
+  // Messages smaller than |threshold| bytes are sent uncompressed even if the
+  // client negotiated permessage-deflate. Must be set before Start().
+  void SetCompressionThreshold(size_t threshold);
+
+  // Must be called from the server thread, e.g. from a message handler.
+  [[nodiscard]] bool IsCompressed(connection_hdl hdl);
+  [[nodiscard]] CompressionStats GetCompressionStats(connection_hdl hdl);
+  [[nodiscard]] SendStats GetSendStats(connection_hdl hdl);
+
 private:
+  using clock_t = std::chrono::steady_clock;
+
+  struct Subscription {
+    clock_t::duration min_interval{};
+    clock_t::time_point last_push{};
+  };
+
+  using shared_provider_t = std::shared_ptr<const payload_provider_t>;
+  using prepared_list_t =
+      std::vector<std::pair<Payload, server_t::message_ptr>>;
+
+  struct Connection {
+    bool deflate{};
+    CompressionStats compression;
+    // Latest-wins slot for a push that could not be sent yet.
+    shared_provider_t pending;
+    uint64_t dropped{};
+  };
+
+  // Pushes the payload of |provider| to a subscriber. Returns false if there
+  // was nothing to send.
+  bool Push(connection_hdl hdl,
+      payload_provider_t const& provider,
+      prepared_list_t& prepared);
+  [[nodiscard]] bool IsBusy(connection_hdl hdl);
+  // Keeps |provider| as the next push of |hdl|, to be sent at |due| or once
+  // the connection has drained.
+  void Defer(connection_hdl hdl,
+      shared_provider_t const& provider,
+      clock_t::time_point due);
+  void ScheduleFlush(clock_t::time_point due);
+  void Flush();
+
+  // Builds a complete server frame that can be queued on any connection not
+  // using permessage-deflate.
+  [[nodiscard]] static server_t::message_ptr Prepare(Payload const& payload);
+  [[nodiscard]] bool CanSharePayload(connection_hdl hdl, size_t size);
+  bool Send(connection_hdl hdl, server_t::message_ptr const& msg);
+
+  bool OnValidate(connection_hdl hdl);
   void OnOpen(connection_hdl hdl);
   void OnClose(connection_hdl hdl);
   void OnMessage(connection_hdl hdl, server_t::message_ptr msg);
 
   std::thread runner_;
   message_handler_t on_message_;
+  close_handler_t on_close_;
+  open_handler_t on_open_;
+  std::vector<std::string> subprotocols_;
+  size_t compression_threshold_{};
   unsigned port_{};
   server_t server_;
+  std::map<connection_hdl, Subscription, std::owner_less<connection_hdl>>
+      subscriptions_;
+  std::atomic<size_t> subscriber_count_{};
+  std::map<connection_hdl, Connection, std::owner_less<connection_hdl>>
+      connections_;
+  bool flush_scheduled_{};
+  clock_t::time_point flush_due_{};
 };
 }  // namespace network
\ No newline at end of file
@@ -0,0 +1,401 @@
+/**
+ * Widget Sensors
+ * Snapshot server
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "websocket/snapshot_server.hpp"
+#include "shared/json_writer.hpp"
+#include <chrono>
+#include <limits>
+#include <vector>
+
+namespace network {
+SnapshotServer::SnapshotServer(unsigned port,
+    core::SnapshotStore& store,
+    core::SensorHistory& history)
+    : server_(port), store_(store), history_(history) {
+  server_.SetSubprotocols(
+      { core::kCborSubprotocol, core::kMsgPackSubprotocol });
+  server_.SetCompressionThreshold(kCompressionThreshold);
+
+  // Server-side projection: {"msg":{"action":"select","data":{"keys":[
+  // "rtss=>framerate","GPU=>GPU Clock"]}}}. An empty list selects all.
+  handlers_.emplace("select", [this](auto&& hdl, auto&& data) {
+    std::vector<std::string> keys;
+    if (data.is_object() && data.contains("keys") && data["keys"].is_array()) {
+      for (auto const& k : data["keys"]) {
+        if (k.is_string())
+          keys.push_back(k.template get<std::string>());
+      }
+    }
+
+    clients_[hdl].projection =
+        keys.empty() ? nullptr : projection_cache_.Find(std::move(keys));
+    UpdateDemand();
+    SendSnapshot(hdl);
+  });
+
+  // Push mode: {"msg":{"action":"subscribe","data":{"maxRate":4}}}, where
+  // maxRate is the maximum number of frames per second (0 = every tick).
+  handlers_.emplace("subscribe", [this](auto&& hdl, auto&& data) {
+    double max_rate{};
+    if (data.is_object() && data.contains("maxRate") &&
+        data["maxRate"].is_number())
+      max_rate = data["maxRate"].template get<double>();
+
+    auto const min_interval = std::chrono::milliseconds(
+        max_rate > 0.0 ? static_cast<int64_t>(1000.0 / max_rate) : 0);
+    server_.Subscribe(hdl, min_interval);
+    clients_[hdl].subscribed = true;
+    SendSnapshot(hdl);
+  });
+  handlers_.emplace("unsubscribe", [this](auto&& hdl, auto&&) {
+    server_.Unsubscribe(hdl);
+    clients_[hdl].subscribed = false;
+  });
+
+  // Delta mode: {"msg":{"action":"delta","data":{"enabled":true,
+  // "autoAck":false}}}. Frames then carry a "seq" and only the sensors that
+  // changed since the last sequence acknowledged with {"msg":{"action":
+  // "ack","data":{"seq":N}}}. With autoAck every frame sent counts as
+  // acknowledged. Clients not subscribed get a reply to each ack.
+  handlers_.emplace("delta", [this](auto&& hdl, auto&& data) {
+    auto& c = clients_[hdl];
+    c.delta = !data.is_object() || !data.contains("enabled") ||
+              data["enabled"] == true;
+    c.auto_ack = data.is_object() && data.contains("autoAck") &&
+                 data["autoAck"] == true;
+    c.base_seq = 0;
+    SendSnapshot(hdl);
+  });
+  handlers_.emplace("ack", [this](auto&& hdl, auto&& data) {
+    auto& c = clients_[hdl];
+    if (data.is_object() && data.contains("seq") &&
+        data["seq"].is_number_unsigned())
+      c.base_seq = data["seq"].template get<uint64_t>();
+
+    if (!c.subscribed)
+      SendSnapshot(hdl);
+  });
+
+  // Compact mode: {"msg":{"action":"compact","data":{"enabled":true}}}. The
+  // client gets a schema message and then flat arrays of values, see
+  // core::CompactEncoder. Takes precedence over delta mode.
+  handlers_.emplace("compact", [this](auto&& hdl, auto&& data) {
+    auto& c = clients_[hdl];
+    c.compact = !data.is_object() || !data.contains("enabled") ||
+                data["enabled"] == true;
+    c.schema_version = 0;
+    SendSnapshot(hdl);
+  });
+
+  handlers_.emplace(
+      "stats", [this](auto&& hdl, auto&&) { SendStats(hdl); });
+  handlers_.emplace("history",
+      [this](auto&& hdl, auto&& data) { SendHistory(hdl, data); });
+}
+
+void SnapshotServer::SetCompressionThreshold(size_t threshold) {
+  server_.SetCompressionThreshold(threshold);
+}
+
+bool SnapshotServer::Start(request_handler_t on_request,
+    demand_handler_t on_demand) {
+  on_request_ = std::move(on_request);
+  on_demand_ = std::move(on_demand);
+  return server_.Start(
+      [this](auto&& hdl, auto&& msg) { OnMessage(hdl, msg); },
+      [this](auto&& hdl) { OnClose(hdl); },
+      [this](auto&& hdl) { OnOpen(hdl); });
+}
+
+void SnapshotServer::Shutdown() {
+  server_.Shutdown();
+}
+
+void SnapshotServer::SetStats(std::string stats) {
+  std::lock_guard lock(stats_mutex_);
+  stats_ = std::move(stats);
+}
+
+bool SnapshotServer::Publish(std::shared_ptr<core::Snapshot> snapshot,
+    int64_t time) {
+  auto const current = store_.Current();
+  if (current != nullptr && current->data == snapshot->data)
+    return false;
+
+  store_.Publish(std::move(snapshot));
+  auto const published = store_.Current();
+  history_.Add(*published, time);
+  server_.Publish([this, published](auto&& hdl) {
+    return GetPayload(hdl, published, true);
+  });
+  return true;
+}
+
+void SnapshotServer::OnMessage(connection_hdl hdl, std::string const& msg) {
+  nlohmann::json request;
+  try {
+    auto json = nlohmann::json::parse(msg);
+    if (json.contains("msg") && json["msg"].is_object())
+      request = std::move(json["msg"]);
+  } catch (...) {
+  }
+
+  if (request.contains("action") && request["action"].is_string()) {
+    auto it = handlers_.find(request["action"].get<std::string>());
+    if (it != handlers_.end()) {
+      it->second(
+          hdl, request.contains("data") ? request["data"] : nlohmann::json{});
+      return;
+    }
+  }
+
+  if (on_request_ == nullptr || !on_request_(request))
+    SendSnapshot(hdl);
+}
+
+void SnapshotServer::OnOpen(connection_hdl hdl) {
+  clients_[hdl].encoding =
+      core::EncodingFromSubprotocol(server_.GetSubprotocol(hdl));
+  UpdateDemand();
+}
+
+void SnapshotServer::OnClose(connection_hdl hdl) {
+  clients_.erase(hdl);
+  UpdateDemand();
+}
+
+// Collects the keys read by the connected clients. Called when a client
+// connects, leaves or changes its projection.
+void SnapshotServer::UpdateDemand() {
+  auto demand = std::make_shared<core::DemandTracker::Demand>();
+  for (auto const& [hdl, c] : clients_) {
+    if (c.projection == nullptr) {
+      demand->everything = true;
+      break;
+    }
+
+    auto const& keys = c.projection->keys();
+    demand->keys.insert(keys.begin(), keys.end());
+  }
+
+  demand_.Set(std::move(demand));
+  if (on_demand_ != nullptr)
+    on_demand_();
+}
+
+void SnapshotServer::SendSnapshot(connection_hdl hdl) {
+  if (auto const snapshot = store_.Current())
+    server_.Send(hdl, GetPayload(hdl, snapshot));
+}
+
+// {"msg":{"action":"stats"}} replies with the compression and push delivery
+// counters of the connection, always as JSON text.
+void SnapshotServer::SendStats(connection_hdl hdl) {
+  auto const stats = server_.GetCompressionStats(hdl);
+  auto const send_stats = server_.GetSendStats(hdl);
+  std::string reply;
+  util::JsonWriter writer(reply);
+  writer.BeginObject();
+  writer.Key("stats");
+  writer.BeginObject();
+  writer.Key("compression");
+  writer.Bool(server_.IsCompressed(hdl));
+  writer.Key("messages");
+  writer.Number(stats.messages);
+  writer.Key("compressedMessages");
+  writer.Number(stats.compressed_messages);
+  writer.Key("bytesIn");
+  writer.Number(stats.bytes_in);
+  writer.Key("bytesOut");
+  writer.Number(stats.bytes_out);
+  writer.Key("ratio");
+  writer.Number(stats.ratio(), 4);
+  writer.Key("compressTimeUs");
+  writer.Number(
+      std::chrono::duration_cast<std::chrono::microseconds>(stats.compress_time)
+          .count());
+  writer.Key("dropped");
+  writer.Number(send_stats.dropped);
+  writer.Key("bufferedBytes");
+  writer.Number(send_stats.buffered_bytes);
+  {
+    std::lock_guard lock(stats_mutex_);
+    writer.RawMembers(stats_);
+  }
+  writer.EndObject();
+  writer.EndObject();
+  server_.Send(hdl, reply.data(), reply.size());
+}
+
+// History: {"msg":{"action":"history","data":{"keys":["GPU=>GPU Clock"],
+// "last":600}}}, or "from" and "to" in milliseconds since the epoch. Without
+// keys, the selected keys or all of them. A "resolution" in milliseconds
+// returns rollup buckets instead of samples. Always JSON text.
+void SnapshotServer::SendHistory(connection_hdl hdl,
+    nlohmann::json const& data) {
+  std::vector<std::string> keys;
+  int64_t from = std::numeric_limits<int64_t>::min();
+  int64_t to = std::numeric_limits<int64_t>::max();
+  int64_t resolution{};
+  size_t last{};
+  if (data.is_object()) {
+    if (data.contains("keys") && data["keys"].is_array()) {
+      for (auto const& k : data["keys"]) {
+        if (k.is_string())
+          keys.push_back(k.get<std::string>());
+      }
+    }
+    if (data.contains("from") && data["from"].is_number_integer())
+      from = data["from"].get<int64_t>();
+    if (data.contains("to") && data["to"].is_number_integer())
+      to = data["to"].get<int64_t>();
+    if (data.contains("last") && data["last"].is_number_unsigned())
+      last = data["last"].get<size_t>();
+    if (data.contains("resolution") && data["resolution"].is_number_unsigned())
+      resolution = data["resolution"].get<int64_t>();
+  }
+
+  if (keys.empty()) {
+    if (auto const& p = clients_[hdl].projection; p != nullptr)
+      keys = p->keys();
+    else
+      history_.Keys(keys);
+  }
+
+  std::string reply;
+  std::vector<core::SensorHistory::Sample> samples;
+  std::vector<core::SensorHistory::Bucket> buckets;
+  util::JsonWriter writer(reply);
+  writer.BeginObject();
+  writer.Key("history");
+  writer.BeginObject();
+  for (auto const& key : keys) {
+    if (resolution > 0) {
+      buckets.clear();
+      if (!history_.QueryRollup(key, resolution, from, to, last, buckets))
+        continue;
+
+      // [time, mean, min, max, count]
+      writer.Key(key);
+      writer.BeginArray();
+      for (auto const& b : buckets) {
+        writer.BeginArray();
+        writer.Number(b.time);
+        writer.Number(b.mean(), 0);
+        writer.Number(b.min);
+        writer.Number(b.max);
+        writer.Number(b.count);
+        writer.EndArray();
+      }
+      writer.EndArray();
+      continue;
+    }
+
+    samples.clear();
+    if (!history_.Query(key, from, to, last, samples))
+      continue;
+
+    writer.Key(key);
+    writer.BeginArray();
+    for (auto const& sample : samples) {
+      writer.BeginArray();
+      writer.Number(sample.time);
+      writer.Number(sample.value, 0);
+      writer.EndArray();
+    }
+    writer.EndArray();
+  }
+  writer.EndObject();
+  if (resolution > 0) {
+    writer.Key("resolution");
+    writer.Number(history_.RollupResolution(resolution));
+  }
+  writer.EndObject();
+  server_.Send(hdl, reply.data(), reply.size());
+}
+
+// Converts a JSON payload for clients that negotiated a binary subprotocol.
+// Falls back to the JSON text if it cannot be converted.
+Payload SnapshotServer::Encode(ClientState const& c,
+    uint64_t seq,
+    Payload payload) {
+  if (c.encoding == core::Encoding::kJson || payload.data.empty())
+    return payload;
+
+  auto encoded =
+      binary_encoder_.Encode(seq, payload.owner, payload.data, c.encoding);
+  if (encoded == nullptr)
+    return payload;
+
+  return { encoded, *encoded, true };
+}
+
+Payload SnapshotServer::GetJsonPayload(connection_hdl hdl,
+    ClientState& c,
+    core::snapshot_ptr_t const& snapshot,
+    bool push) {
+  if (c.compact) {
+    auto const frame = compact_encoder_.Get(snapshot, c.projection);
+    if (c.schema_version != frame.version) {
+      c.schema_version = frame.version;
+      server_.Send(
+          hdl, Encode(c, snapshot->seq, { frame.schema, *frame.schema }));
+    }
+    return { frame.values, *frame.values };
+  }
+
+  if (c.delta) {
+    auto const frame = delta_encoder_.Get(snapshot, c.base_seq, c.projection);
+    if (c.auto_ack)
+      c.base_seq = snapshot->seq;
+
+    if (push && !frame.full && frame.changed == 0)
+      return {};
+
+    return { frame.payload, *frame.payload };
+  }
+
+  if (c.projection != nullptr) {
+    auto payload = c.projection->Get(snapshot);
+    return { payload, *payload };
+  }
+
+  return { snapshot, snapshot->data };
+}
+
+// Returns what |hdl| should get for |snapshot|. When |push| is set and the
+// client is in delta mode, an empty payload means there is nothing new.
+// Compact clients are sent the schema first whenever it changes.
+Payload SnapshotServer::GetPayload(connection_hdl hdl,
+    core::snapshot_ptr_t const& snapshot,
+    bool push) {
+  auto it = clients_.find(hdl);
+  if (it == clients_.end())
+    return { snapshot, snapshot->data };
+
+  auto& c = it->second;
+  return Encode(c, snapshot->seq, GetJsonPayload(hdl, c, snapshot, push));
+}
+}  // namespace network
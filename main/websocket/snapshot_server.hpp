@@ -0,0 +1,137 @@
+/**
+ * Widget Sensors
+ * Snapshot server
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "core/binary.hpp"
+#include "core/compact.hpp"
+#include "core/delta.hpp"
+#include "core/demand.hpp"
+#include "core/history.hpp"
+#include "core/projection.hpp"
+#include "core/snapshot.hpp"
+#include "websocket/server.hpp"
+#include "nlohmann/json.hpp"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace network {
+// Serves the published snapshots and the sensor history to websocket
+// clients, each in the form it asked for: the keys it selected, pushed or on
+// request, as full, delta or compact frames, in JSON or a binary
+// subprotocol. The server and the replay tool both publish through it.
+class SnapshotServer {
+public:
+  // Gets the "msg" object of requests whose action is not handled here, or
+  // null if the request could not be parsed. When it returns false, the
+  // client is sent the current snapshot.
+  using request_handler_t = std::function<bool(nlohmann::json const&)>;
+  // Called on the server thread when the keys read by the clients change.
+  using demand_handler_t = std::function<void()>;
+
+  // Messages smaller than this are sent uncompressed by default.
+  static constexpr size_t kCompressionThreshold = 256;
+
+  SnapshotServer(unsigned port,
+      core::SnapshotStore& store,
+      core::SensorHistory& history);
+
+  // Must be called before Start().
+  void SetCompressionThreshold(size_t threshold);
+  bool Start(request_handler_t on_request = nullptr,
+      demand_handler_t on_demand = nullptr);
+  void Shutdown();
+
+  // Publishes |snapshot|, taken at |time| in milliseconds since the epoch, to
+  // the store, the history and the subscribed clients. Returns false without
+  // publishing if it holds the same data as the current snapshot. Must only
+  // be called from the thread publishing snapshots.
+  bool Publish(std::shared_ptr<core::Snapshot> snapshot, int64_t time);
+
+  // Sets JSON members, in the form "key":{...},..., added to the reply of
+  // the "stats" action. Can be called from any thread.
+  void SetStats(std::string stats);
+
+  // Keys read by the connected clients.
+  [[nodiscard]] std::shared_ptr<const core::DemandTracker::Demand> demand()
+      const {
+    return demand_.Get();
+  }
+
+private:
+  // Per connection state. Only accessed from the server thread.
+  struct ClientState {
+    std::shared_ptr<core::Projection> projection;
+    bool subscribed{};
+    bool delta{};
+    bool auto_ack{};
+    uint64_t base_seq{};
+    bool compact{};
+    uint32_t schema_version{};
+    core::Encoding encoding{};
+  };
+  using connection_handler_t =
+      std::function<void(connection_hdl, nlohmann::json const&)>;
+
+  void OnMessage(connection_hdl hdl, std::string const& msg);
+  void OnOpen(connection_hdl hdl);
+  void OnClose(connection_hdl hdl);
+  void UpdateDemand();
+
+  void SendSnapshot(connection_hdl hdl);
+  void SendStats(connection_hdl hdl);
+  void SendHistory(connection_hdl hdl, nlohmann::json const& data);
+
+  Payload Encode(ClientState const& c, uint64_t seq, Payload payload);
+  Payload GetJsonPayload(connection_hdl hdl,
+      ClientState& c,
+      core::snapshot_ptr_t const& snapshot,
+      bool push);
+  Payload GetPayload(connection_hdl hdl,
+      core::snapshot_ptr_t const& snapshot,
+      bool push = false);
+
+  WebsocketServer server_;
+  core::SnapshotStore& store_;
+  core::SensorHistory& history_;
+  core::ProjectionCache projection_cache_;
+  core::DeltaEncoder delta_encoder_;
+  core::CompactEncoder compact_encoder_;
+  core::BinaryEncoder binary_encoder_;
+  core::DemandTracker demand_;
+  std::map<connection_hdl, ClientState, std::owner_less<connection_hdl>>
+      clients_;
+  std::unordered_map<std::string, connection_handler_t> handlers_;
+  request_handler_t on_request_;
+  demand_handler_t on_demand_;
+  mutable std::mutex stats_mutex_;
+  std::string stats_;
+};
+}  // namespace network
@@ -0,0 +1,144 @@
+/**
+ * Widget Sensors
+ * Allocation benchmark plug-in
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "shared/platform.hpp"
+#include "shared/plugin_writer.hpp"
+#include "shared/widget_plugin.h"
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// Counts the heap allocations made by WriteValues. Each poll writes
+// kSensors HWiNFO-like sensors through util::PluginOutput, as API v2 plugins
+// do, then builds the same values as a std::wstring, as API v1 plugins did,
+// and reports both counts and times as sensors:
+//   "alloc_bench=>allocations", "alloc_bench=>allocationsV1",
+//   "alloc_bench=>writeTimeUs", "alloc_bench=>writeTimeUsV1"
+// operator new is replaced in this DLL only, so allocations made by the host
+// while it appends the output are not counted.
+
+namespace {
+constexpr size_t kSensors = 200;
+
+thread_local uint64_t allocations{};
+uint64_t tick{};
+
+// Value of sensor |i|, in tenths of a degree.
+uint64_t ValueOf(size_t i) {
+  return 300 + (i * 7 + tick) % 700;
+}
+
+void WriteV2(util::PluginOutput& out) {
+  for (size_t i = 0; i < kSensors; i++) {
+    auto const v = ValueOf(i);
+    out << "\"alloc_bench=>Sensor " << i << "\":{\"sensor\":\"Sensor " << i
+        << "\",\"value\":\"" << v / 10 << "." << v % 10
+        << " \xc2\xb0" "C\",\"valueRaw\":\"" << v / 10 << "." << v % 10
+        << "\"},";
+  }
+}
+
+std::wstring WriteV1() {
+  std::wstring out;
+  for (size_t i = 0; i < kSensors; i++) {
+    auto const v = ValueOf(i);
+    auto const value = std::to_wstring(v / 10) + L"." + std::to_wstring(v % 10);
+    out += L"\"alloc_bench=>Sensor " + std::to_wstring(i) +
+           L"\":{\"sensor\":\"Sensor " + std::to_wstring(i) +
+           L"\",\"value\":\"" + value + L" \u00b0C\",\"valueRaw\":\"" + value +
+           L"\"},";
+  }
+  return out;
+}
+
+void WriteCount(util::PluginOutput& out, const char* name, uint64_t value) {
+  out << "\"alloc_bench=>" << name << "\":{\"sensor\":\"" << name
+      << "\",\"value\":" << value << "}";
+}
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations++;
+  if (auto* p = std::malloc(size != 0 ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+// Begin exported functions
+bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path&, bool) {
+  return true;
+}
+
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t*, PluginWriter* writer) {
+  using us_t = std::chrono::microseconds;
+  using std::chrono::steady_clock;
+  tick++;
+
+  util::PluginOutput out(writer);
+  auto const before = allocations;
+  auto start = steady_clock::now();
+  WriteV2(out);
+  out.Flush();
+  auto const v2_time = steady_clock::now() - start;
+  auto const v2_allocations = allocations - before;
+
+  start = steady_clock::now();
+  auto const v1 = WriteV1();
+  auto const v1_time = steady_clock::now() - start;
+  auto const v1_allocations = allocations - before - v2_allocations;
+
+  WriteCount(out, "allocations", v2_allocations);
+  out << ",";
+  WriteCount(out, "allocationsV1", v1_allocations);
+  out << ",";
+  WriteCount(out, "writeTimeUs",
+      std::chrono::duration_cast<us_t>(v2_time).count());
+  out << ",";
+  WriteCount(out, "writeTimeUsV1",
+      std::chrono::duration_cast<us_t>(v1_time).count());
+  return !v1.empty();
+}
+
+void DECLDLL PLUGIN ShutdownPlugin() {
+}
+// End exported functions
+
+BOOL WINAPI DllMain(HINSTANCE, DWORD, LPVOID) {
+  return TRUE;
+}
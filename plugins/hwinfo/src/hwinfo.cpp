@@ -24,10 +24,10 @@
  * SOFTWARE.
  */
 #include "hwinfo.hpp"
+#include "shared/json_writer.hpp"
 #include "shared/logger.hpp"
 #include <chrono>
 #include <memory>
-#include <sstream>
 #include <unordered_map>
 
 namespace windows {
@@ -94,9 +94,13 @@ void HwInfo::Shutdown() {
   }
 }
 
-std::wstring HwInfo::GetData() {
+void HwInfo::AttachSensors(SensorHost const* host) {
+  sensors_.Attach(host);
+}
+
+void HwInfo::WriteData(util::PluginOutput& out) {
   std::shared_lock lock(mutex_);
-  return cached_data_;
+  out << cached_data_;
 }
 
 void HwInfo::Runner() {
@@ -118,6 +122,7 @@ void HwInfo::Runner() {
 
   HANDLE handles[] = { change_event, quit_event_ };
   key_list_t list;
+  std::string data;
   DWORD res;
   for (;;) {
     registry_notify();
@@ -128,7 +133,10 @@ void HwInfo::Runner() {
 
     ReadRegistry(list);
 
-    std::wostringstream o;
+    // "value" is the text shown by HWiNFO, e.g. "3,724.8 MHz" or "45,5 °C"
+    // depending on the locale. "valueRaw" is the locale independent number,
+    // e.g. "3724.8", which is what clients and the history should parse.
+    data.clear();
     for (auto&& [k, v] : list) {
       auto&& [sensor, label, value, value_raw] = v;
       const auto s = sensor.get();
@@ -138,16 +146,29 @@ void HwInfo::Runner() {
       if (s[0] == L'P' && s[11] == L'[' && s[1] == L'r')
         s[11] = L'\0';
 
-      o << L"\"" << sensor << L"=>" << label << L"\": {\"index\":" << k
-        << L",\"sensor\": \"" << label << L"\",\"value\":\"" << value
-        << L"\",\"valueRaw\":\"" << value_raw << L"\"},";
+      if (!data.empty())
+        data.push_back(',');
+
+      data.push_back('"');
+      util::AppendUtf8(data, sensor.get(), true);
+      data.append("=>");
+      util::AppendUtf8(data, label.get(), true);
+      data.append("\": {\"index\":");
+      data.append(std::to_string(k));
+      data.append(",\"sensor\": \"");
+      util::AppendUtf8(data, label.get(), true);
+      data.append("\",\"value\":\"");
+      util::AppendUtf8(data, value.get(), true);
+      data.append("\",\"valueRaw\":\"");
+      util::AppendUtf8(data, value_raw.get(), true);
+      data.append("\"}");
     }
 
     {
       std::unique_lock lock(mutex_);
-      cached_data_ = std::move(o.str());
-      cached_data_.pop_back();
+      cached_data_.swap(data);
     }
+    sensors_.NotifyChanged();
   }
 
   CloseHandle(change_event);
@@ -195,7 +216,7 @@ void HwInfo::ReadRegistry(key_list_t& list) {
       continue;
 
     get_value(keys_[i][2].get(), std::get<2>(list[i]).get());
-    // get_value(keys[i][3].get(), std::get<3>(list[i]).get());
+    get_value(keys_[i][3].get(), std::get<3>(list[i]).get());
   }
 }
 }  // namespace windows
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 #include "shared/platform.hpp"
+#include "shared/plugin_sensors.hpp"
+#include "shared/plugin_writer.hpp"
 #include <array>
 #include <chrono>
 #include <memory>
 #include <shared_mutex>
+#include <string>
 #include <thread>
 #include <unordered_map>
 
@@ -22,7 +25,10 @@ public:
   bool Initialize();
   void Shutdown();
 
-  [[nodiscard]] std::wstring GetData();
+  void WriteData(util::PluginOutput& out);
+
+  // Only used to tell the host when the registry changed.
+  void AttachSensors(SensorHost const* host);
 
 private:
   void Runner();
@@ -38,6 +44,7 @@ private:
   HKEY key_{};
   std::array<std::array<std::unique_ptr<wchar_t[]>, 4>, kMaxKeys> keys_;
 
-  std::wstring cached_data_;
+  std::string cached_data_;  // UTF-8
+  util::PluginSensors sensors_;
 };
 }  // namespace windows
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "shared/platform.hpp"
 #include "shared/logger.hpp"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_writer.hpp"
 #include "shared/string_util.h"
 #include "hwinfo.hpp"
 #include <string>
@@ -23,11 +24,23 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& data_dir,
   return init;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
   if (!init)
-    return L"";
+    return false;
+
+  util::PluginOutput out(writer);
+  hwinfo.WriteData(out);
+  return true;
+}
 
-  return hwinfo.GetData();
+bool DECLDLL PLUGIN RegisterSensors(SensorHost const* host) {
+  hwinfo.AttachSensors(host);
+  return true;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
@@ -26,6 +26,7 @@
 #include "shared/platform.hpp"
 #include "shared/string_util.h"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_sensors.hpp"
 #include "shared/logger.hpp"
 #include "obs.hpp"
 #include "nlohmann/json.hpp"
@@ -54,12 +55,18 @@ std::unique_ptr<network::ObsWebClient> obs;
 std::promise<void> cancel_stop_buffer;
 std::shared_future<void> future;
 
+util::PluginSensors sensors;
+uint32_t streaming_sensor = kInvalidSensorId;
+
 void StartObsWebSocketClient() {
   LOG(INFO) << "Starting ObsWebSocket client using IP: " << obs_config.host
             << " port: " << obs_config.port;
   obs = std::make_unique<network::ObsWebClient>(obs_config.data_dir,
       obs_config.host, obs_config.port, obs_config.password);
-  obs->Start();
+  obs->Start(nullptr, [](network::OutputState const& state) {
+    sensors.SetBool(streaming_sensor, state.streaming);
+    sensors.NotifyChanged();
+  });
 }
 }  // namespace
 
@@ -102,11 +109,22 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& data_dir,
   return true;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
   auto const& state = obs->GetOutputState();
-  return string2wstring(fmt::format(
-      "\"obs=>streaming\":{{\"sensor\":\"streaming\",\"value\":{}}}",
-      state.streaming ? "true" : "false"));
+  sensors.SetBool(streaming_sensor, state.streaming);
+  return true;
+}
+
+bool DECLDLL PLUGIN RegisterSensors(SensorHost const* host) {
+  sensors.Attach(host);
+  streaming_sensor =
+      sensors.Add("obs=>streaming", "streaming", "", SensorType::kBool);
+  return streaming_sensor != kInvalidSensorId;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
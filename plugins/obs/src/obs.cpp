@@ -72,10 +72,14 @@ ObsWebClient::~ObsWebClient() {
   runner_.join();
 }
 
-bool ObsWebClient::Start(message_handler_t on_message) {
+bool ObsWebClient::Start(message_handler_t on_message,
+    state_handler_t on_state_changed) {
   if (on_message)
     on_message_ = std::move(on_message);
 
+  if (on_state_changed)
+    on_state_changed_ = std::move(on_state_changed);
+
   client_.set_open_handler(bind(&ObsWebClient::OnOpen, this, _1));
   client_.set_fail_handler(bind(&ObsWebClient::OnFail, this, _1));
   client_.set_message_handler(bind(&ObsWebClient::OnMessage, this, _1, _2));
@@ -166,6 +170,9 @@ void ObsWebClient::OnClose(connection_hdl hdl) {
 
 bool ObsWebClient::StreamStateChanged(nlohmann::json const& event_data) {
   state_.streaming = event_data["outputActive"];
+  if (on_state_changed_)
+    on_state_changed_(state_);
+
   if (!state_.streaming)
     return true;
 
@@ -176,6 +183,9 @@ bool ObsWebClient::StreamStateChanged(nlohmann::json const& event_data) {
 
 bool ObsWebClient::ReplayBufferStateChanged(nlohmann::json const& event_data) {
   state_.replay_buffer = event_data["outputActive"];
+  if (on_state_changed_)
+    on_state_changed_(state_);
+
   if (!state_.replay_buffer)
     return true;
 
@@ -17,6 +17,7 @@ struct OutputState {
   bool replay_buffer{};
   bool streaming{};
 };
+using state_handler_t = std::function<void(OutputState const&)>;
 
 class ObsWebClient {
 public:
@@ -28,7 +29,8 @@ public:
       std::string password);
   ~ObsWebClient();
 
-  bool Start(message_handler_t on_message = nullptr);
+  bool Start(message_handler_t on_message = nullptr,
+      state_handler_t on_state_changed = nullptr);
   bool Send(connection_hdl hdl, const char* data, size_t size);
   void Shutdown();
 
@@ -61,6 +63,7 @@ private:
   std::filesystem::path data_dir_;
   std::thread runner_;
   message_handler_t on_message_;
+  state_handler_t on_state_changed_;
   std::string host_;
   unsigned port_{};
   std::string password_;
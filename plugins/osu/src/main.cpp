@@ -27,6 +27,7 @@
 #include "shared/simple_db.hpp"
 #include "shared/string_util.h"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_writer.hpp"
 #include "shared/logger.hpp"
 #include "osu.hpp"
 #include "nlohmann/json.hpp"
@@ -137,10 +138,17 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& d,
   return true;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
-  return string2wstring(fmt::format(
-      "\"osu=>game_name\":{{\"sensor\":\"game\",\"value\":\"{}\"}}",
-      current_game));
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
+  util::PluginOutput out(writer);
+  out << "\"osu=>game_name\":{\"sensor\":\"game\",\"value\":\"";
+  out.Escaped(current_game);
+  out << "\"}";
+  return true;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
@@ -26,6 +26,7 @@
 #include "shared/platform.hpp"
 #include "shared/logger.hpp"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_sensors.hpp"
 #include "nvapi/nvapi.h"
 #include "nvapi/NvApiDriverSettings.h"
 #include <iostream>
@@ -34,6 +35,7 @@
 #include <fstream>
 #include <filesystem>
 #include <map>
+#include <string_view>
 
 namespace {
 namespace NvDrv {
@@ -55,6 +57,9 @@ struct {
   }
 } rebar_status;
 
+util::PluginSensors sensors;
+uint32_t enabled_sensor = kInvalidSensorId;
+
 std::string wstring2string(const std::wstring& wstr) {
   auto dest_size = WideCharToMultiByte(
       CP_UTF8, 0, wstr.c_str(), -1, nullptr, 0, 0, 0);
@@ -91,14 +96,15 @@ bool CheckReBar(NvDRSSessionHandle hSession, NvDRSProfileHandle hProfile) {
   return true;
 }
 
-bool FindGameProfile(std::wstring executable) {
+bool FindGameProfile(std::wstring_view executable_name) {
   if (!init)
     return false;
-  else if (rebar_status.profile == executable)
+  else if (rebar_status.profile == executable_name)
     return rebar_status.value;
 
-  rebar_status.profile = executable;
+  rebar_status.profile = executable_name;
   rebar_status.value = false;
+  auto& executable = rebar_status.profile;
 
   // (1) Create the session handle to access driver settings
   NvDRSSessionHandle hSession = 0;
@@ -150,21 +156,31 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& data_dir,
   return true;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
   if (!init)
-    return L"";
+    return false;
 
-  std::wstring res;
-  if (profile_name.empty()) {
+  bool enabled{};
+  if (*profile_name == L'\0') {
     if (!rebar_status.profile.empty())
       rebar_status.Reset();
-
-    res = L"false";
   } else {
-    res = FindGameProfile(profile_name) ? L"\"true\"" : L"\"false\"";
+    enabled = FindGameProfile(profile_name);
   }
 
-  return L"\"rebar\":{\"sensor\":\"enabled\",\"value\":" + res + L"}";
+  sensors.SetBool(enabled_sensor, enabled);
+  return true;
+}
+
+bool DECLDLL PLUGIN RegisterSensors(SensorHost const* host) {
+  sensors.Attach(host);
+  enabled_sensor = sensors.Add("rebar", "enabled", "", SensorType::kBool);
+  return enabled_sensor != kInvalidSensorId;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
@@ -26,6 +26,7 @@
 #include "shared/platform.hpp"
 #include "shared/logger.hpp"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_sensors.hpp"
 #include "core/process_tracker.hpp"
 #include "core/process_watcher.hpp"
 #include "shared/string_util.h"
@@ -38,6 +39,9 @@ bool init = false;
 int64_t elapsed_time{};
 std::string current_profile;
 
+util::PluginSensors sensors;
+uint32_t elapsed_sensor = kInvalidSensorId;
+
 core::ProcessWatcher watcher;
 core::ProcessTracker tracker;
 
@@ -60,6 +64,7 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& data_dir,
                 << " seconds. PID: " << pid;
       tracker.Delete(pid);
     }
+    sensors.NotifyChanged();
   });
 
   init = true;
@@ -67,7 +72,12 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& data_dir,
   return true;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
   if (current_profile.empty()) {
     elapsed_time = {};
   } else {
@@ -77,8 +87,15 @@ std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
     }
   }
 
-  return L"\"tracker\":{\"sensor\":\"elapsedTime\",\"value\":" +
-         std::to_wstring(elapsed_time) + L"}";
+  sensors.SetNumber(elapsed_sensor, static_cast<double>(elapsed_time));
+  return true;
+}
+
+bool DECLDLL PLUGIN RegisterSensors(SensorHost const* host) {
+  sensors.Attach(host);
+  elapsed_sensor =
+      sensors.Add("tracker", "elapsedTime", "", SensorType::kInteger);
+  return elapsed_sensor != kInvalidSensorId;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
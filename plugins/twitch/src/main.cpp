@@ -27,6 +27,7 @@
 #include "shared/simple_db.hpp"
 #include "shared/string_util.h"
 #include "shared/widget_plugin.h"
+#include "shared/plugin_sensors.hpp"
 #include "shared/logger.hpp"
 #include "twitch.hpp"
 #include "nlohmann/json.hpp"
@@ -66,6 +67,10 @@ core::SimpleDb game_db;
 std::string current_game;
 std::string current_poster;
 
+util::PluginSensors sensors;
+uint32_t game_name_sensor = kInvalidSensorId;
+uint32_t game_cover_sensor = kInvalidSensorId;
+
 template<typename T>
 T GetConfigOrDefaultValue(nlohmann::json const& j,
     std::string k,
@@ -201,11 +206,25 @@ bool DECLDLL PLUGIN InitPlugin(const std::filesystem::path& d,
   return true;
 }
 
-std::wstring DECLDLL PLUGIN GetValues(const std::wstring& profile_name) {
-  return string2wstring(fmt::format(
-      "\"twitch=>game_name\":{{\"sensor\":\"game\",\"value\":\"{}\"}},"
-      "\"twitch=>game_cover\":{{\"sensor\":\"game\",\"value\":\"{}\"}}",
-      current_game, current_poster));
+uint32_t DECLDLL PLUGIN GetPluginApiVersion() {
+  return kPluginApiVersion;
+}
+
+bool DECLDLL PLUGIN WriteValues(const wchar_t* profile_name,
+    PluginWriter* writer) {
+  sensors.SetString(game_name_sensor, current_game);
+  sensors.SetString(game_cover_sensor, current_poster);
+  return true;
+}
+
+bool DECLDLL PLUGIN RegisterSensors(SensorHost const* host) {
+  sensors.Attach(host);
+  game_name_sensor =
+      sensors.Add("twitch=>game_name", "game", "", SensorType::kString);
+  game_cover_sensor =
+      sensors.Add("twitch=>game_cover", "game", "", SensorType::kString);
+  return game_name_sensor != kInvalidSensorId &&
+         game_cover_sensor != kInvalidSensorId;
 }
 
 void DECLDLL PLUGIN ShutdownPlugin() {
@@ -310,6 +329,7 @@ void DECLDLL PLUGIN ProfileChanged(const std::string& pname) {
                 << " poster: " << current_poster;
       twitch->SetBroadcastInfo(game_id, title);
       current_game = std::move(game);
+      sensors.NotifyChanged();
     } else {
       LOG(ERROR) << "Profile for " << pname << " was not found!";
     }
@@ -0,0 +1,146 @@
+/**
+ * Widget Sensors
+ * Session replay
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/history.hpp"
+#include "core/replay.hpp"
+#include "core/snapshot.hpp"
+#include "websocket/snapshot_server.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+
+// Serves a recorded session to websocket clients as if it was sampled live,
+// without any plugin, so the websocket path can be load tested and clients
+// checked against real data on any platform:
+//   widget-replay <recording> [--speed N] [--loop] [--port N]
+// <recording> is a segment file, a directory of segments or a JSON-lines
+// capture. --speed 0 replays as fast as possible.
+
+namespace {
+constexpr unsigned kDefaultPort = 30001;
+constexpr size_t kSnapshotReserve = 20000;
+constexpr size_t kHistorySamples = 14400;
+
+std::atomic<bool> quit{};
+
+void OnSignal(int) {
+  quit = true;
+}
+
+int Usage() {
+  std::cerr << "Usage: widget-replay <recording> [--speed N] [--loop] "
+               "[--port N]"
+            << std::endl;
+  return 1;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2)
+    return Usage();
+
+  double speed = 1.0;
+  bool loop = false;
+  unsigned port = kDefaultPort;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--loop") == 0) {
+      loop = true;
+    } else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = static_cast<unsigned>(std::atoi(argv[++i]));
+    } else {
+      return Usage();
+    }
+  }
+
+  core::ReplayReader reader;
+  if (!reader.Open(argv[1])) {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  core::SnapshotStore store(kSnapshotReserve);
+  core::SensorHistory history(
+      kHistorySamples, core::SensorHistory::DefaultLevels());
+  network::SnapshotServer server(port, store, history);
+  if (!server.Start()) {
+    std::cerr << "Could not start websocket server on port " << port
+              << std::endl;
+    return 2;
+  }
+
+  std::cout << "Websocket server listening to port " << port << std::endl;
+  std::signal(SIGINT, &OnSignal);
+  std::signal(SIGTERM, &OnSignal);
+
+  // Each pass of a looped replay is shifted after the previous one, so the
+  // history and the clients see time going forward.
+  core::ReplayClock clock(speed);
+  core::ReplayFrame frame;
+  int64_t offset{};
+  int64_t first_time = std::numeric_limits<int64_t>::min();
+  int64_t last_time{};
+  uint64_t frames{};
+  uint64_t published{};
+  auto const start = std::chrono::steady_clock::now();
+  while (!quit) {
+    if (!reader.Next(frame)) {
+      if (!loop || frames == 0 || !reader.Rewind() || !reader.Next(frame))
+        break;
+
+      offset += last_time - first_time + core::ReplayReader::kCaptureIntervalMs;
+      first_time = std::numeric_limits<int64_t>::min();
+    }
+
+    frame.time += offset;
+    if (first_time == std::numeric_limits<int64_t>::min())
+      first_time = frame.time;
+    last_time = frame.time;
+
+    std::this_thread::sleep_until(clock.Due(frame.time));
+    auto snapshot = store.Acquire();
+    snapshot->data = frame.data;
+    if (server.Publish(std::move(snapshot), frame.time))
+      published++;
+    frames++;
+  }
+
+  auto const elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start);
+  std::cout << "Replayed " << frames << " frames, " << published
+            << " published, in " << elapsed.count() << " s ("
+            << (elapsed.count() > 0 ? frames / elapsed.count() : 0.0)
+            << " frames/s)" << std::endl;
+
+  server.Shutdown();
+  return 0;
+}
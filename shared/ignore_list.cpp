@@ -62,6 +62,7 @@ bool IgnoreList::LoadList(std::filesystem::path filename) {
       std::string exe = i["exe"];
       data_.emplace(ToLower(exe));
     }
+    version_++;
 
     if (file_watcher_ == INVALID_HANDLE_VALUE) {
       auto p = filename_;
@@ -88,6 +89,7 @@ bool IgnoreList::AddProcess(std::filesystem::path const& path) {
   if (!IsIgnoredProcess(path)) {
     std::unique_lock lock(mutex_);
     data_.emplace(path.u8string());
+    version_++;
     return true;
   }
 
@@ -24,6 +24,7 @@
  */
 #pragma once
 #include "shared/platform.hpp"
+#include <atomic>
 #include <filesystem>
 #include <shared_mutex>
 #include <set>
@@ -37,6 +38,9 @@ public:
   [[nodiscard]] bool LoadList(std::filesystem::path filename);
   [[nodiscard]] bool IsIgnoredProcess(std::filesystem::path path);
   bool AddProcess(std::filesystem::path const& path);
+  [[nodiscard]] uint32_t GetVersion() const {
+    return version_.load();
+  }
 
   void Save();
   void WatcherThread();
@@ -45,6 +49,7 @@ private:
   std::filesystem::path filename_;
   std::set<std::string> data_;
   std::shared_mutex mutex_;
+  std::atomic<uint32_t> version_{};
   HANDLE watcher_thread_ {};
   HANDLE file_watcher_{ INVALID_HANDLE_VALUE };
   HANDLE quit_event_{};
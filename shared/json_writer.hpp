@@ -0,0 +1,289 @@
+/**
+ * Widget Sensors
+ * UTF-8 JSON writer
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+// Appends UTF-16 (or UTF-32, depending on wchar_t) text to |out| as UTF-8.
+// When |escape| is set the text is escaped to be used inside a JSON string.
+// |out| is a std::string or anything with the same push_back() and append().
+template<typename Out>
+void AppendUtf8(Out& out, std::wstring_view in, bool escape) {
+  constexpr char kHex[] = "0123456789abcdef";
+  for (size_t i = 0; i < in.size(); i++) {
+    auto c = static_cast<uint32_t>(in[i]);
+    if constexpr (sizeof(wchar_t) == 2) {
+      if (c >= 0xd800 && c <= 0xdbff && i + 1 < in.size()) {
+        auto const low = static_cast<uint32_t>(in[i + 1]);
+        if (low >= 0xdc00 && low <= 0xdfff) {
+          c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+          i++;
+        }
+      }
+    }
+
+    if (c >= 0xd800 && c <= 0xdfff)
+      c = 0xfffd;
+
+    if (c < 0x80) {
+      if (escape && (c == '"' || c == '\\')) {
+        out.push_back('\\');
+        out.push_back(static_cast<char>(c));
+      } else if (escape && c < 0x20) {
+        out.append("\\u00");
+        out.push_back(kHex[c >> 4]);
+        out.push_back(kHex[c & 0xf]);
+      } else {
+        out.push_back(static_cast<char>(c));
+      }
+    } else if (c < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    } else if (c < 0x10000) {
+      out.push_back(static_cast<char>(0xe0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xf0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    }
+  }
+}
+
+// Writes JSON text straight into a caller-owned UTF-8 buffer. The buffer is
+// cleared but never shrunk on Reset(), so once it has grown to the size of a
+// snapshot the writer does not allocate anymore.
+class JsonWriter {
+public:
+  JsonWriter() = default;
+  explicit JsonWriter(std::string& out) {
+    Reset(out);
+  }
+
+  void Reset(std::string& out) {
+    out_ = &out;
+    out_->clear();
+    depth_ = 0;
+    first_[0] = true;
+    after_key_ = false;
+  }
+
+  [[nodiscard]] std::string& buffer() const {
+    return *out_;
+  }
+
+  void BeginObject() {
+    Separator();
+    out_->push_back('{');
+    Push();
+  }
+
+  void EndObject() {
+    Pop();
+    out_->push_back('}');
+  }
+
+  void BeginArray() {
+    Separator();
+    out_->push_back('[');
+    Push();
+  }
+
+  void EndArray() {
+    Pop();
+    out_->push_back(']');
+  }
+
+  void Key(std::string_view key) {
+    Separator();
+    out_->push_back('"');
+    AppendEscaped(key);
+    out_->append("\":");
+    after_key_ = true;
+  }
+
+  // Appends a key that is already escaped.
+  void RawKey(std::string_view key) {
+    Separator();
+    out_->push_back('"');
+    out_->append(key);
+    out_->append("\":");
+    after_key_ = true;
+  }
+
+  void String(std::string_view value) {
+    Separator();
+    out_->push_back('"');
+    AppendEscaped(value);
+    out_->push_back('"');
+  }
+
+  void String(std::wstring_view value) {
+    Separator();
+    out_->push_back('"');
+    AppendUtf8(*out_, value, true);
+    out_->push_back('"');
+  }
+
+  void String(const char* value) {
+    String(std::string_view(value));
+  }
+
+  void String(const wchar_t* value) {
+    String(std::wstring_view(value));
+  }
+
+  // Same output as the default precision of an ostream, e.g. 59.9 or 144.
+  // A |precision| of 0 writes the shortest text that reads back the same.
+  // NaN and infinities have no JSON representation and are written as null.
+  void Number(double value, int precision = 6) {
+    if (!std::isfinite(value)) {
+      Null();
+      return;
+    }
+
+    Separator();
+    std::array<char, 32> buf;
+    auto const res = precision > 0
+                         ? std::to_chars(buf.data(), buf.data() + buf.size(),
+                               value, std::chars_format::general, precision)
+                         : std::to_chars(
+                               buf.data(), buf.data() + buf.size(), value);
+    out_->append(buf.data(), res.ptr - buf.data());
+  }
+
+  template<typename T,
+      std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>,
+          int> = 0>
+  void Number(T value) {
+    Separator();
+    std::array<char, 24> buf;
+    auto const res = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    out_->append(buf.data(), res.ptr - buf.data());
+  }
+
+  void Bool(bool value) {
+    Separator();
+    out_->append(value ? "true" : "false");
+  }
+
+  void Null() {
+    Separator();
+    out_->append("null");
+  }
+
+  // Appends an already formatted JSON value.
+  void RawValue(std::string_view value) {
+    Separator();
+    out_->append(value);
+  }
+
+  // Appends a string that is already escaped.
+  void RawString(std::string_view value) {
+    Separator();
+    out_->push_back('"');
+    out_->append(value);
+    out_->push_back('"');
+  }
+
+  // Appends already formatted JSON members, e.g. a plugin fragment in the form
+  // "key":{...},"key2":{...}. Empty fragments are skipped.
+  void RawMembers(std::string_view members) {
+    if (members.empty())
+      return;
+
+    Separator();
+    out_->append(members);
+  }
+
+  void RawMembers(std::wstring_view members) {
+    if (members.empty())
+      return;
+
+    Separator();
+    AppendUtf8(*out_, members, false);
+  }
+
+private:
+  static constexpr size_t kInitialDepth = 16;
+
+  void Separator() {
+    if (after_key_) {
+      after_key_ = false;
+      return;
+    }
+
+    if (!first_[depth_])
+      out_->push_back(',');
+
+    first_[depth_] = false;
+  }
+
+  // Only grows past kInitialDepth levels, which snapshots never reach.
+  void Push() {
+    if (++depth_ == first_.size())
+      first_.push_back(true);
+
+    first_[depth_] = true;
+  }
+
+  void Pop() {
+    if (depth_ > 0)
+      depth_--;
+  }
+
+  void AppendEscaped(std::string_view value) {
+    constexpr char kHex[] = "0123456789abcdef";
+    for (auto const ch : value) {
+      auto const c = static_cast<unsigned char>(ch);
+      if (c == '"' || c == '\\') {
+        out_->push_back('\\');
+        out_->push_back(ch);
+      } else if (c < 0x20) {
+        out_->append("\\u00");
+        out_->push_back(kHex[c >> 4]);
+        out_->push_back(kHex[c & 0xf]);
+      } else {
+        out_->push_back(ch);
+      }
+    }
+  }
+
+  std::string* out_{};
+  std::vector<bool> first_ = std::vector<bool>(kInitialDepth);
+  size_t depth_{};
+  bool after_key_{};
+};
+}  // namespace util
@@ -0,0 +1,79 @@
+/**
+ * Widget Sensors
+ * Plugin typed sensors
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "shared/widget_plugin.h"
+#include <atomic>
+#include <string_view>
+
+namespace util {
+// Plugin side wrapper around the host's SensorHost. Calls made before the
+// host is attached, or with an invalid id, are ignored.
+class PluginSensors {
+public:
+  void Attach(SensorHost const* host) {
+    host_ = host;
+  }
+
+  [[nodiscard]] bool attached() const {
+    return host_ != nullptr;
+  }
+
+  uint32_t Add(const char* key,
+      const char* label,
+      const char* unit,
+      SensorType type) {
+    auto const host = host_.load();
+    if (host == nullptr)
+      return kInvalidSensorId;
+
+    return host->add_sensor(host->context, key, label, unit, type);
+  }
+
+  void SetNumber(uint32_t id, double value) {
+    if (auto const host = host_.load(); host != nullptr)
+      host->set_number(host->context, id, value);
+  }
+
+  void SetBool(uint32_t id, bool value) {
+    if (auto const host = host_.load(); host != nullptr)
+      host->set_bool(host->context, id, value);
+  }
+
+  void SetString(uint32_t id, std::string_view value) {
+    if (auto const host = host_.load(); host != nullptr)
+      host->set_string(host->context, id, value.data(), value.size());
+  }
+
+  // Asks the host to poll the plugin as soon as possible.
+  void NotifyChanged() {
+    if (auto const host = host_.load(); host != nullptr)
+      host->notify_changed(host->context);
+  }
+
+private:
+  std::atomic<SensorHost const*> host_{};
+};
+}  // namespace util
@@ -0,0 +1,129 @@
+/**
+ * Widget Sensors
+ * Plugin output writer
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+#include "shared/json_writer.hpp"
+#include "shared/widget_plugin.h"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace util {
+// Plugin side of the v2 ABI. Text is gathered in a small stack buffer and
+// handed to the host writer when it fills up or the object goes out of
+// scope, so writing values does not allocate.
+class PluginOutput {
+public:
+  explicit PluginOutput(PluginWriter* writer) : writer_(writer) {}
+  ~PluginOutput() {
+    Flush();
+  }
+
+  PluginOutput(PluginOutput const&) = delete;
+  PluginOutput& operator=(PluginOutput const&) = delete;
+
+  PluginOutput& operator<<(std::string_view s) {
+    if (size_ + s.size() > buffer_.size()) {
+      Flush();
+      if (s.size() > buffer_.size()) {
+        writer_->append(writer_->context, s.data(), s.size());
+        return *this;
+      }
+    }
+
+    memcpy(buffer_.data() + size_, s.data(), s.size());
+    size_ += s.size();
+    return *this;
+  }
+
+  PluginOutput& operator<<(const char* s) {
+    return *this << std::string_view(s);
+  }
+
+  PluginOutput& operator<<(std::wstring_view s) {
+    AppendUtf8(*this, s, false);
+    return *this;
+  }
+
+  template<typename T,
+      std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>,
+          int> = 0>
+  PluginOutput& operator<<(T value) {
+    std::array<char, 24> buf;
+    auto const res = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    return *this << std::string_view(buf.data(), res.ptr - buf.data());
+  }
+
+  // Writes |s| escaped to be used inside a JSON string.
+  PluginOutput& Escaped(std::wstring_view s) {
+    AppendUtf8(*this, s, true);
+    return *this;
+  }
+
+  PluginOutput& Escaped(std::string_view s) {
+    constexpr char kHex[] = "0123456789abcdef";
+    for (auto const ch : s) {
+      auto const c = static_cast<unsigned char>(ch);
+      if (c == '"' || c == '\\') {
+        push_back('\\');
+        push_back(ch);
+      } else if (c < 0x20) {
+        append("\\u00");
+        push_back(kHex[c >> 4]);
+        push_back(kHex[c & 0xf]);
+      } else {
+        push_back(ch);
+      }
+    }
+    return *this;
+  }
+
+  // Used by AppendUtf8().
+  void push_back(char c) {
+    if (size_ == buffer_.size())
+      Flush();
+
+    buffer_[size_++] = c;
+  }
+
+  void append(const char* s) {
+    *this << std::string_view(s);
+  }
+
+  void Flush() {
+    if (size_ > 0)
+      writer_->append(writer_->context, buffer_.data(), size_);
+
+    size_ = 0;
+  }
+
+private:
+  PluginWriter* writer_;
+  std::array<char, 512> buffer_;
+  size_t size_{};
+};
+}  // namespace util
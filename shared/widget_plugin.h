@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <string>
 
@@ -11,4 +13,53 @@ typedef std::wstring(PLUGIN* GetValues_t)(
     const std::filesystem::path& profile_name);
 typedef bool(PLUGIN* ShutdownPlugin_t)();
 typedef bool(PLUGIN* ExecuteCommand_t)(const std::string& command);
-typedef void(PLUGIN* ProfileChanged_t)(const std::string& profile_name);
\ No newline at end of file
+typedef void(PLUGIN* ProfileChanged_t)(const std::string& profile_name);
+
+// Plugin ABI v2. Plugins export GetPluginApiVersion, returning
+// kPluginApiVersion, and WriteValues instead of GetValues. WriteValues
+// appends the plugin's JSON members ("key":{...},"key2":{...}) as UTF-8 to
+// a buffer owned by the host, so nothing crosses the DLL boundary but plain
+// C types. Plugins without GetPluginApiVersion are loaded as v1.
+constexpr uint32_t kPluginApiVersion = 2;
+
+struct PluginWriter {
+  void* context;
+  void(PLUGIN* append)(void* context, const char* data, size_t size);
+};
+
+typedef uint32_t(PLUGIN* GetPluginApiVersion_t)();
+// |profile_name| is null terminated, empty when no game is running.
+typedef bool(PLUGIN* WriteValues_t)(const wchar_t* profile_name,
+    PluginWriter* writer);
+
+// Typed sensors. Plugins that export RegisterSensors get a host table to
+// publish values into instead of, or in addition to, formatting JSON in
+// WriteValues. Sensors are added once and then updated by id from any
+// thread; the host serializes them and skips values that did not change.
+// |host| stays valid until ShutdownPlugin returns.
+//
+// Plugins that know when their data changes call notify_changed, from any
+// thread, to be polled right away rather than on their next sampling tick.
+enum class SensorType : uint32_t { kNumber, kInteger, kBool, kString };
+
+constexpr uint32_t kInvalidSensorId = ~uint32_t{};
+
+struct SensorHost {
+  void* context;
+  // |key|, |label| and |unit| are null terminated UTF-8. Returns
+  // kInvalidSensorId on failure.
+  uint32_t(PLUGIN* add_sensor)(void* context,
+      const char* key,
+      const char* label,
+      const char* unit,
+      SensorType type);
+  void(PLUGIN* set_number)(void* context, uint32_t id, double value);
+  void(PLUGIN* set_bool)(void* context, uint32_t id, bool value);
+  void(PLUGIN* set_string)(void* context,
+      uint32_t id,
+      const char* value,
+      size_t size);
+  void(PLUGIN* notify_changed)(void* context);
+};
+
+typedef bool(PLUGIN* RegisterSensors_t)(SensorHost const* host);
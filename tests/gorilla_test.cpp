@@ -0,0 +1,97 @@
+/**
+ * Widget Sensors
+ * Gorilla series tests
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/gorilla.hpp"
+#include <cstdio>
+#include <vector>
+
+// Samples read back as appended, and kept in time order when the clock goes
+// backwards.
+
+namespace {
+int failures = 0;
+
+#define CHECK(expr)                                                       \
+  do {                                                                    \
+    if (!(expr)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (false)
+
+constexpr int64_t kStart = 1700000000000;
+
+void TestRoundTrip() {
+  core::GorillaSeries series;
+  size_t const count = core::GorillaBlock::kMaxSamples * 2 + 7;
+  for (size_t i = 0; i < count; i++)
+    series.Append(kStart + static_cast<int64_t>(i) * 1000, 40.0 + i % 9);
+
+  std::vector<core::TimedValue> out;
+  series.Query(INT64_MIN, INT64_MAX, 0, out);
+  CHECK(out.size() == count);
+  bool exact = out.size() == count;
+  for (size_t i = 0; exact && i < count; i++)
+    exact = out[i].time == kStart + static_cast<int64_t>(i) * 1000 &&
+            out[i].value == 40.0 + i % 9;
+  CHECK(exact);
+}
+
+void TestClockBackwards() {
+  core::GorillaSeries series;
+  for (int64_t i = 0; i < 10; i++)
+    series.Append(kStart + i * 1000, static_cast<double>(i));
+  // The clock is set back by a minute, then keeps going from there.
+  for (int64_t i = 0; i < 5; i++)
+    series.Append(kStart - 60000 + i * 1000, 100.0 + i);
+
+  std::vector<core::TimedValue> out;
+  series.Query(INT64_MIN, INT64_MAX, 0, out);
+  CHECK(out.size() == 15);
+  bool ordered = true;
+  for (size_t i = 1; i < out.size(); i++)
+    ordered = ordered && out[i - 1].time <= out[i].time;
+  CHECK(ordered);
+
+  // The newest samples are the ones taken after the clock moved.
+  out.clear();
+  series.Query(INT64_MIN, INT64_MAX, 3, out);
+  CHECK(out.size() == 3);
+  CHECK(out.size() == 3 && out[0].value == 102.0 && out[2].value == 104.0);
+  CHECK(out.size() == 3 && out[2].time == kStart + 9000);
+}
+}  // namespace
+
+int main() {
+  TestRoundTrip();
+  TestClockBackwards();
+
+  if (failures != 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
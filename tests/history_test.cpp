@@ -0,0 +1,147 @@
+/**
+ * Widget Sensors
+ * Sensor history tests
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/history.hpp"
+#include <cstdio>
+#include <string>
+
+// Rollups weighted by time, and sensors dropped once gone for long enough.
+
+namespace {
+int failures = 0;
+
+#define CHECK(expr)                                                       \
+  do {                                                                    \
+    if (!(expr)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (false)
+
+constexpr int64_t kStart = 1700000040000;  // On a minute
+
+core::Snapshot MakeSnapshot(std::string const& members) {
+  core::Snapshot s;
+  s.data = "{\"sensors\":{" + members + "}}";
+  s.Index();
+  return s;
+}
+
+core::Snapshot Temperature(double value) {
+  return MakeSnapshot("\"gpu=>temp\":{\"sensor\":\"temp\",\"value\":" +
+                      std::to_string(value) + "}");
+}
+
+void TestTimeWeightedMean() {
+  core::SensorHistory history(0, { { 60000, 10 } });
+  // 50 for 45 s, then 70 changing every second for 15 s.
+  history.Add(Temperature(50), kStart);
+  for (int64_t t = 45000; t < 60000; t += 1000)
+    history.Add(Temperature(70), kStart + t);
+  history.Add(Temperature(60), kStart + 60000);
+
+  std::vector<core::SensorHistory::Bucket> buckets;
+  CHECK(history.QueryRollup("gpu=>temp", 60000, 0, kStart * 2, 0, buckets));
+  CHECK(buckets.size() == 2);
+  if (buckets.size() != 2)
+    return;
+
+  auto const& b = buckets[0];
+  CHECK(b.time == kStart);
+  CHECK(b.count == 16);
+  CHECK(b.duration == 60000);
+  CHECK(b.mean() == 55.0);
+  CHECK(b.min == 50.0f && b.max == 70.0f);
+  CHECK(buckets[1].count == 1 && buckets[1].mean() == 60.0);
+}
+
+void TestCarryAcrossBuckets() {
+  core::SensorHistory history(0, { { 60000, 10 } });
+  history.Add(Temperature(40), kStart + 30000);
+  history.Add(Temperature(80), kStart + 3 * 60000);
+
+  // 40 held through the two minutes in between, without samples.
+  std::vector<core::SensorHistory::Bucket> buckets;
+  CHECK(history.QueryRollup("gpu=>temp", 60000, 0, kStart * 2, 0, buckets));
+  CHECK(buckets.size() == 4);
+  if (buckets.size() != 4)
+    return;
+
+  CHECK(buckets[0].count == 1 && buckets[0].duration == 30000);
+  CHECK(buckets[1].count == 0 && buckets[1].mean() == 40.0);
+  CHECK(buckets[2].count == 0 && buckets[2].duration == 60000);
+  CHECK(buckets[3].count == 1 && buckets[3].mean() == 80.0);
+}
+
+void TestMissingSensor() {
+  core::SensorHistory history(0, { { 60000, 10 } });
+  auto const other = MakeSnapshot("\"cpu=>load\":5");
+  history.Add(Temperature(40), kStart);
+  history.Add(other, kStart + 30000);
+  history.Add(Temperature(80), kStart + 50000);
+  history.Add(Temperature(80), kStart + 60000);
+
+  // Nothing is known of the sensor while it was missing.
+  std::vector<core::SensorHistory::Bucket> buckets;
+  CHECK(history.QueryRollup("gpu=>temp", 60000, 0, kStart * 2, 0, buckets));
+  CHECK(!buckets.empty() && buckets[0].duration == 10000 &&
+        buckets[0].mean() == 80.0);
+}
+
+void TestPrune() {
+  // The coarsest rollup covers 10 minutes.
+  core::SensorHistory history(16, { { 1000, 60 }, { 60000, 10 } });
+  auto const other = MakeSnapshot("\"cpu=>load\":5");
+  history.Add(Temperature(40), kStart);
+  for (int64_t t = 60000; t <= 10 * 60000; t += 60000)
+    history.Add(other, kStart + t);
+
+  std::vector<std::string> keys;
+  history.Keys(keys);
+  CHECK(keys.size() == 2);
+
+  history.Add(other, kStart + 11 * 60000);
+  keys.clear();
+  history.Keys(keys);
+  CHECK(keys.size() == 1 && keys[0] == "cpu=>load");
+
+  std::vector<core::SensorHistory::Sample> samples;
+  CHECK(!history.Query("gpu=>temp", 0, kStart * 2, 0, samples));
+}
+}  // namespace
+
+int main() {
+  TestTimeWeightedMean();
+  TestCarryAcrossBuckets();
+  TestMissingSensor();
+  TestPrune();
+
+  if (failures != 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
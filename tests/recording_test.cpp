@@ -0,0 +1,271 @@
+/**
+ * Widget Sensors
+ * Session recording tests
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/recording.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Segment files written by SegmentWriter and read back by SegmentReader.
+
+namespace {
+int failures = 0;
+
+#define CHECK(expr)                                                       \
+  do {                                                                    \
+    if (!(expr)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (false)
+
+constexpr int64_t kStart = 1700000000000;
+constexpr int64_t kPeriod = 250;
+constexpr size_t kChunkFrames = 16;
+
+// A snapshot of frame |i|: a number with a unit, display text and a string.
+core::Snapshot MakeSnapshot(size_t i) {
+  core::Snapshot s;
+  auto const n = std::to_string(i);
+  s.data = "{\"sensors\":{"
+           "\"cpu=>clock\":{\"sensor\":\"CPU Clock\",\"value\":\"3,7" + n +
+           ".5 MHz\",\"valueRaw\":\"37" + n + ".5\"},"
+           "\"rtss=>framerate\":{\"sensor\":\"framerate\",\"value\":" + n +
+           "},"
+           "\"rtss=>process\":{\"sensor\":\"process\",\"value\":\"game" + n +
+           ".exe\"}}}";
+  s.Index();
+  return s;
+}
+
+int64_t TimeOf(size_t i) {
+  return kStart + static_cast<int64_t>(i) * kPeriod;
+}
+
+// Writes |chunks| chunks of kChunkFrames frames to |dir|.
+bool WriteChunks(std::filesystem::path const& dir, size_t chunks,
+    size_t segment_size) {
+  core::SegmentWriter writer(dir, segment_size);
+  core::Chunk chunk;
+  for (size_t i = 0; i < chunks * kChunkFrames; i++) {
+    if (!chunk.Add(MakeSnapshot(i), TimeOf(i)))
+      return false;
+    if (chunk.frames() == kChunkFrames) {
+      if (!writer.Write(chunk))
+        return false;
+      chunk.Clear();
+    }
+  }
+  writer.Close();
+  return true;
+}
+
+void CheckFrame(core::Chunk const& chunk, size_t frame, size_t i) {
+  auto const n = std::to_string(i);
+  CHECK(chunk.times[frame] == TimeOf(i));
+  CHECK(chunk.columns[0].numbers[frame] == std::stod("37" + n + ".5"));
+  CHECK(chunk.columns[1].numbers[frame] == static_cast<double>(i));
+
+  // Every value is kept as it was published.
+  auto const snapshot = MakeSnapshot(i);
+  for (size_t c = 0; c < chunk.columns.size(); c++)
+    CHECK(chunk.columns[c].texts[frame] == snapshot.entries[c].value);
+}
+
+void TestChunkRoundTrip() {
+  core::Chunk chunk;
+  for (size_t i = 0; i < kChunkFrames; i++)
+    CHECK(chunk.Add(MakeSnapshot(i), TimeOf(i)));
+
+  core::Snapshot other;
+  other.data = "{\"sensors\":{\"gpu=>load\":{\"value\":1}}}";
+  other.Index();
+  CHECK(!chunk.Add(other, TimeOf(kChunkFrames)));
+  CHECK(chunk.frames() == kChunkFrames);
+
+  std::string payload;
+  chunk.Serialize(payload);
+  core::Chunk parsed;
+  CHECK(parsed.Parse(payload));
+  CHECK(parsed.frames() == kChunkFrames);
+  CHECK(parsed.columns.size() == 3);
+  if (parsed.frames() != kChunkFrames || parsed.columns.size() != 3)
+    return;
+
+  CHECK(parsed.columns[0].key == "cpu=>clock");
+  CHECK(parsed.columns[0].label == "\"CPU Clock\"");
+  CHECK(parsed.columns[0].unit == "MHz");
+  CHECK(parsed.columns[0].type == core::ColumnType::kNumber);
+  CHECK(parsed.columns[1].type == core::ColumnType::kNumber);
+  CHECK(parsed.columns[2].type == core::ColumnType::kText);
+  for (size_t i = 0; i < kChunkFrames; i++)
+    CheckFrame(parsed, i, i);
+
+  // Every truncation of the payload is rejected rather than read past.
+  for (size_t size = 0; size < payload.size(); size++)
+    CHECK(!parsed.Parse(std::string_view(payload).substr(0, size)));
+}
+
+void TestSegmentRoundTrip(std::filesystem::path const& dir) {
+  constexpr size_t kChunks = 20;
+  // Small segments, so that the chunks span several of them.
+  CHECK(WriteChunks(dir, kChunks, 4096));
+
+  auto const segments = core::ListSegments(dir);
+  CHECK(segments.size() > 1);
+  size_t next = 0;
+  for (auto const& path : segments) {
+    core::SegmentReader reader;
+    CHECK(reader.Open(path));
+    for (size_t c = 0; c < reader.chunk_count(); c++) {
+      core::Chunk chunk;
+      CHECK(reader.Read(c, chunk));
+      CHECK(chunk.frames() == kChunkFrames);
+      CHECK(reader.header(c).first_time == TimeOf(next));
+      if (chunk.frames() != kChunkFrames || chunk.columns.size() != 3)
+        return;
+      for (size_t f = 0; f < chunk.frames(); f++)
+        CheckFrame(chunk, f, next++);
+    }
+  }
+  CHECK(next == kChunks * kChunkFrames);
+}
+
+void TestSeek(std::filesystem::path const& dir) {
+  constexpr size_t kChunks = 8;
+  CHECK(WriteChunks(dir, kChunks, 1 << 20));
+
+  auto const segments = core::ListSegments(dir);
+  CHECK(segments.size() == 1);
+  core::SegmentReader reader;
+  CHECK(!segments.empty() && reader.Open(segments[0]));
+  CHECK(reader.chunk_count() == kChunks);
+
+  CHECK(reader.Seek(kStart - 1) == 0);
+  CHECK(reader.Seek(kStart) == 0);
+  for (size_t c = 0; c < kChunks; c++) {
+    auto const first = c * kChunkFrames;
+    auto const last = first + kChunkFrames - 1;
+    CHECK(reader.Seek(TimeOf(first)) == c);
+    CHECK(reader.Seek(TimeOf(first) + 1) == c);
+    CHECK(reader.Seek(TimeOf(last)) == c);
+    CHECK(reader.Seek(TimeOf(last) + 1) == c + 1);
+  }
+  CHECK(reader.Seek(TimeOf(kChunks * kChunkFrames)) == kChunks);
+
+  core::Chunk chunk;
+  CHECK(reader.Read(reader.Seek(TimeOf(5 * kChunkFrames + 3)), chunk));
+  if (chunk.frames() == kChunkFrames && chunk.columns.size() == 3)
+    CheckFrame(chunk, 0, 5 * kChunkFrames);
+  CHECK(!reader.Read(kChunks, chunk));
+}
+
+void TestCorruptedTail(std::filesystem::path const& dir) {
+  constexpr size_t kChunks = 4;
+  CHECK(WriteChunks(dir, kChunks, 1 << 20));
+  auto const segments = core::ListSegments(dir);
+  CHECK(segments.size() == 1);
+  if (segments.size() != 1)
+    return;
+
+  auto const path = segments[0];
+  auto const size = std::filesystem::file_size(path);
+  size_t last_offset, last_size;
+  {
+    core::SegmentReader reader;
+    CHECK(reader.Open(path));
+    CHECK(reader.chunk_count() == kChunks);
+    last_size = sizeof(core::ChunkHeader) + reader.header(kChunks - 1).size;
+    last_offset = size - last_size;
+  }
+
+  // A flipped byte in the payload of the last chunk fails its checksum, and
+  // only that chunk is lost.
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekg(static_cast<std::streamoff>(size - 1));
+    auto const c = static_cast<char>(f.get() ^ 0x5a);
+    f.seekp(static_cast<std::streamoff>(size - 1));
+    f.put(c);
+  }
+  {
+    core::SegmentReader reader;
+    CHECK(reader.Open(path));
+    CHECK(reader.chunk_count() == kChunks);
+    core::Chunk chunk;
+    for (size_t c = 0; c + 1 < kChunks; c++)
+      CHECK(reader.Read(c, chunk));
+    CHECK(!reader.Read(kChunks - 1, chunk));
+  }
+
+  // A chunk cut short, as after a crash while writing it, is not indexed.
+  std::filesystem::resize_file(path, last_offset + last_size / 2);
+  {
+    core::SegmentReader reader;
+    CHECK(reader.Open(path));
+    CHECK(reader.chunk_count() == kChunks - 1);
+    core::Chunk chunk;
+    CHECK(reader.Read(kChunks - 2, chunk));
+    CHECK(reader.Seek(TimeOf(kChunks * kChunkFrames - 1)) == kChunks - 1);
+  }
+
+  // So is a header without the rest of its chunk.
+  std::filesystem::resize_file(path, last_offset + sizeof(uint32_t));
+  {
+    core::SegmentReader reader;
+    CHECK(reader.Open(path));
+    CHECK(reader.chunk_count() == kChunks - 1);
+  }
+
+  // A segment without its magic is not read at all.
+  std::filesystem::resize_file(path, 4);
+  {
+    core::SegmentReader reader;
+    CHECK(!reader.Open(path));
+  }
+}
+}  // namespace
+
+int main() {
+  auto const root = std::filesystem::temp_directory_path() /
+                    ("recording_test-" +
+                        std::to_string(std::chrono::steady_clock::now()
+                                           .time_since_epoch()
+                                           .count()));
+  std::error_code ec;
+  TestChunkRoundTrip();
+  TestSegmentRoundTrip(root / "round_trip");
+  TestSeek(root / "seek");
+  TestCorruptedTail(root / "corrupted_tail");
+  std::filesystem::remove_all(root, ec);
+
+  if (failures != 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
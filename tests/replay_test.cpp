@@ -0,0 +1,147 @@
+/**
+ * Widget Sensors
+ * Session replay tests
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/replay.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Recorded snapshots replayed by ReplayReader, which must be the snapshots
+// that were recorded, to the byte.
+
+namespace {
+int failures = 0;
+
+#define CHECK(expr)                                                       \
+  do {                                                                    \
+    if (!(expr)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (false)
+
+constexpr int64_t kStart = 1700000000000;
+constexpr int64_t kPeriod = 250;
+constexpr size_t kFrames = 100;
+constexpr size_t kChunkFrames = 16;
+
+// Snapshot JSON of frame |i|, with the values a number column does not hold
+// as they were: display text with thousands separators, extra members,
+// numbers sent as strings, booleans, nulls and unicode escapes.
+std::string MakeData(size_t i) {
+  auto const n = std::to_string(i);
+  auto const slow = std::to_string(i / 8);
+  return "{\"sensors\":{"
+         "\"hwinfo=>CPU Clock\":{\"index\":3,\"sensor\":\"CPU Clock\","
+         "\"value\":\"3,7" + slow + "4.8 MHz\",\"valueRaw\":\"37" + slow +
+         "4.8\"},"
+         "\"rtss=>framerate\":{\"sensor\":\"framerate\",\"value\":" + n +
+         ".50},"
+         "\"rtss=>active\":{\"sensor\":\"active\",\"value\":" +
+         (i % 3 == 0 ? "true" : "false") + "},"
+         "\"twitch=>viewers\":\"" + n + "\","
+         "\"plugin=>twitch\":\"ok\","
+         "\"steam=>game\":{\"sensor\":\"game\",\"value\":" +
+         (i < 50 ? "null" : "\"Caf\\u00e9\"") + "}}}";
+}
+
+int64_t TimeOf(size_t i) {
+  return kStart + static_cast<int64_t>(i) * kPeriod;
+}
+
+void TestWriteSnapshot() {
+  core::Chunk chunk;
+  for (size_t i = 0; i < kChunkFrames; i++) {
+    core::Snapshot s;
+    s.data = MakeData(i);
+    CHECK(s.Index());
+    CHECK(chunk.Add(s, TimeOf(i)));
+  }
+
+  // Through the segment format too, which only stores a text once while it
+  // does not change.
+  std::string payload;
+  chunk.Serialize(payload);
+  core::Chunk parsed;
+  CHECK(parsed.Parse(payload));
+  CHECK(parsed.frames() == kChunkFrames);
+
+  std::string out;
+  for (size_t i = 0; i < parsed.frames(); i++) {
+    core::WriteSnapshot(parsed, i, out);
+    CHECK(out == MakeData(i));
+  }
+}
+
+void TestReplayDirectory(std::filesystem::path const& dir) {
+  {
+    core::SegmentWriter writer(dir, 4096);
+    core::Chunk chunk;
+    for (size_t i = 0; i < kFrames; i++) {
+      core::Snapshot s;
+      s.data = MakeData(i);
+      CHECK(s.Index());
+      CHECK(chunk.Add(s, TimeOf(i)));
+      if (chunk.frames() == kChunkFrames || i + 1 == kFrames) {
+        CHECK(writer.Write(chunk));
+        chunk.Clear();
+      }
+    }
+  }
+
+  core::ReplayReader reader;
+  CHECK(reader.Open(dir));
+  for (int pass = 0; pass < 2; pass++) {
+    core::ReplayFrame frame;
+    size_t i = 0;
+    while (reader.Next(frame)) {
+      CHECK(frame.time == TimeOf(i));
+      CHECK(frame.data == MakeData(i));
+      i++;
+    }
+    CHECK(i == kFrames);
+    CHECK(reader.Rewind());
+  }
+}
+}  // namespace
+
+int main() {
+  auto const root = std::filesystem::temp_directory_path() /
+                    ("replay_test-" +
+                        std::to_string(std::chrono::steady_clock::now()
+                                           .time_since_epoch()
+                                           .count()));
+  std::error_code ec;
+  TestWriteSnapshot();
+  TestReplayDirectory(root / "replay");
+  std::filesystem::remove_all(root, ec);
+
+  if (failures != 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
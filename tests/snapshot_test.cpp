@@ -0,0 +1,162 @@
+/**
+ * Widget Sensors
+ * Snapshot index tests
+ * Copyright (C) 2021-2023 John Mautari - All rights reserved
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "core/snapshot.hpp"
+#include "shared/json_writer.hpp"
+#include <cstdio>
+#include <string>
+
+// Snapshots indexed as they are written must get the entries Index() finds
+// by parsing them.
+
+namespace {
+int failures = 0;
+
+#define CHECK(expr)                                                       \
+  do {                                                                    \
+    if (!(expr)) {                                                        \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (false)
+
+bool SameEntries(core::Snapshot const& a, core::Snapshot const& b) {
+  if (a.entries.size() != b.entries.size() ||
+      a.key_set_hash != b.key_set_hash)
+    return false;
+
+  for (size_t i = 0; i < a.entries.size(); i++) {
+    auto const& x = a.entries[i];
+    auto const& y = b.entries[i];
+    if (x.key != y.key || x.member != y.member || x.value != y.value ||
+        x.hash != y.hash || x.label != y.label || x.display != y.display ||
+        x.raw != y.raw)
+      return false;
+  }
+  return true;
+}
+
+// Written the way the sampler writes snapshots: its own sensors, then for
+// each plugin a state sensor and the plugin's fragment.
+void Write(core::Snapshot& s,
+    std::vector<std::string> const& fragments,
+    std::vector<std::vector<core::SensorEntry>> const& indexes) {
+  auto const& data = s.data;
+  util::JsonWriter writer(s.data);
+  s.BeginIndex();
+  writer.BeginObject();
+  writer.Key("sensors");
+  writer.BeginObject();
+  auto const builtin = data.size();
+  writer.Key("rtss=>framerate");
+  writer.BeginObject();
+  writer.Key("sensor");
+  writer.String("framerate");
+  writer.Key("value");
+  writer.Number(143.5);
+  writer.EndObject();
+  writer.Key("custom_cover");
+  writer.String("");
+  s.IndexMembers(builtin);
+
+  for (size_t i = 0; i < fragments.size(); i++) {
+    auto const state = data.size();
+    writer.Key("plugin=>p" + std::to_string(i));
+    writer.BeginObject();
+    writer.Key("value");
+    writer.String("ready");
+    writer.EndObject();
+    s.IndexMembers(state);
+
+    writer.RawMembers(fragments[i]);
+    s.AddMembers(data.size() - fragments[i].size(), fragments[i], indexes[i]);
+  }
+  writer.EndObject();
+  writer.EndObject();
+  CHECK(s.EndIndex());
+}
+
+void TestWriteIndex() {
+  std::vector<std::string> const fragments = {
+    "\"hwinfo=>CPU\":{\"index\":3,\"sensor\":\"CPU Clock\","
+    "\"value\":\"3,724.8 MHz\",\"valueRaw\":\"3724.8\"},"
+    "\"hwinfo=>GPU\":{\"sensor\":\"GPU\",\"value\":\"61 \\u00b0C\"}",
+    "",
+    "\"twitch=>viewers\":\"12\",\"twitch=>live\":true,\"twitch=>x\":null",
+  };
+  std::vector<std::vector<core::SensorEntry>> indexes(fragments.size());
+  for (size_t i = 0; i < fragments.size(); i++)
+    CHECK(core::IndexMembers(fragments[i], indexes[i]));
+
+  core::Snapshot written;
+  // Small, so that the buffer grows while the snapshot is written.
+  written.data.reserve(16);
+  Write(written, fragments, indexes);
+  CHECK(written.indexed);
+  CHECK(written.entries.size() == 2 + 3 + 2 + 3);
+
+  core::Snapshot parsed;
+  parsed.data = written.data;
+  CHECK(parsed.Index());
+  CHECK(SameEntries(written, parsed));
+
+  // Views point into the snapshot, not into the indexed fragments.
+  for (auto const& e : written.entries) {
+    CHECK(e.member.data() >= written.data.data() &&
+          e.member.data() + e.member.size() <=
+              written.data.data() + written.data.size());
+  }
+
+  // Reused buffers are indexed again when published without EndIndex().
+  core::SnapshotStore store(0);
+  auto s = store.Acquire();
+  s->data = parsed.data;
+  store.Publish(s);
+  CHECK(SameEntries(*store.Current(), parsed));
+}
+
+void TestIndexMembers() {
+  std::vector<core::SensorEntry> entries;
+  CHECK(core::IndexMembers("", entries) && entries.empty());
+  CHECK(core::IndexMembers(",\"a\":1", entries) && entries.size() == 1);
+  CHECK(core::IndexMembers(" \"a\" : 1 , \"b\":{\"value\":2} ", entries));
+  CHECK(entries.size() == 2 && entries[1].display == "2");
+  CHECK(!core::IndexMembers("\"a\":1,\"b\"", entries));
+  CHECK(entries.size() == 1);
+  CHECK(!core::IndexMembers("\"a\":1}", entries));
+}
+}  // namespace
+
+int main() {
+  TestWriteIndex();
+  TestIndexMembers();
+
+  if (failures != 0) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}